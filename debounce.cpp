@@ -0,0 +1,151 @@
+#include "debounce.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// =============================================================
+// Option parsing
+// =============================================================
+
+bool parse_debounce_option(const char *option, DebounceConfiguration &configuration) {
+	static const char *class_names[SWITCH_CLASSES] = {"toggle", "momentary", "encoder"};
+
+	const char *separator = strchr(option, '=');
+
+	if(!separator) {
+		return false;
+	}
+
+	int switch_class = -1;
+
+	for(int i = 0; i < SWITCH_CLASSES; i++) {
+		if(strlen(class_names[i]) == (size_t) (separator - option) && strncmp(option, class_names[i], separator - option) == 0) {
+			switch_class = i;
+		}
+	}
+
+	if(switch_class < 0) {
+		return false;
+	}
+
+	char *end;
+	double press_ms = strtod(separator + 1, &end);
+	double release_ms = press_ms;
+
+	if(end == separator + 1 || press_ms < 0) {
+		return false;
+	}
+
+	if(*end == '/') {
+		const char *release = end + 1;
+
+		release_ms = strtod(release, &end);
+
+		if(end == release || release_ms < 0) {
+			return false;
+		}
+	}
+
+	if(*end != '\0') {
+		return false;
+	}
+
+	configuration.times[switch_class].press_us = (uint32_t) (press_ms * 1000);
+	configuration.times[switch_class].release_us = (uint32_t) (release_ms * 1000);
+
+	return true;
+}
+
+// =============================================================
+// SwitchDebouncer
+// =============================================================
+
+SwitchDebouncer::SwitchDebouncer():
+	press_ns{},
+	release_ns{},
+	stable{},
+	pending{},
+	pending_since_ns{},
+	seeded{false},
+	bounces{0} {
+}
+
+void SwitchDebouncer::configure(const DebounceConfiguration &configuration) {
+	for(int row = 0; row < 3; row++) {
+		for(int col = 0; col < 12; col++) {
+			press_ns[row][col] = 0;
+			release_ns[row][col] = 0;
+
+			for(int switch_class = 0; switch_class < SWITCH_CLASSES; switch_class++) {
+				if(configuration.class_rows[switch_class][row] & (1u << col)) {
+					press_ns[row][col] = configuration.times[switch_class].press_us * 1000ull;
+					release_ns[row][col] = configuration.times[switch_class].release_us * 1000ull;
+				}
+			}
+		}
+	}
+
+	seeded = false;
+}
+
+bool SwitchDebouncer::update(const uint16_t raw[3], uint64_t now_ns, uint16_t debounced[3]) {
+	// The first sample is taken as it is
+	if(!seeded) {
+		for(int row = 0; row < 3; row++) {
+			stable[row] = raw[row];
+			pending[row] = 0;
+			debounced[row] = raw[row];
+		}
+
+		seeded = true;
+
+		return true;
+	}
+
+	bool changed = false;
+
+	for(int row = 0; row < 3; row++) {
+		uint16_t differing = raw[row] ^ stable[row];
+
+		// Positions back at their debounced state before their time was up
+		uint16_t bounced = pending[row] & ~differing;
+
+		if(bounced) {
+			bounces.fetch_add(__builtin_popcount(bounced), std::memory_order_relaxed);
+		}
+
+		// Positions that started to differ in this sample
+		for(uint16_t bits = differing & ~pending[row]; bits; bits &= bits - 1) {
+			pending_since_ns[row][__builtin_ctz(bits)] = now_ns;
+		}
+
+		pending[row] = differing;
+
+		if(!differing) {
+			debounced[row] = stable[row];
+			continue;
+		}
+
+		uint16_t accepted = 0;
+
+		for(uint16_t bits = differing; bits; bits &= bits - 1) {
+			int col = __builtin_ctz(bits);
+			uint64_t required_ns = ((raw[row] >> col) & 1) ? press_ns[row][col] : release_ns[row][col];
+
+			if(now_ns - pending_since_ns[row][col] >= required_ns) {
+				accepted |= (1u << col);
+			}
+		}
+
+		if(accepted) {
+			stable[row] ^= accepted;
+			pending[row] &= ~accepted;
+
+			changed = true;
+		}
+
+		debounced[row] = stable[row];
+	}
+
+	return changed;
+}
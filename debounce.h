@@ -0,0 +1,72 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <atomic>
+#include <cstdint>
+
+// =============================================================
+// Debounce configuration
+// =============================================================
+
+enum class SwitchClass {
+	Toggle,
+	Momentary,
+	Encoder
+};
+
+constexpr int SWITCH_CLASSES = 3;
+
+// How long a switch must read closed (press) or open (release) before the change is accepted
+struct DebounceTimes {
+	uint32_t press_us;
+	uint32_t release_us;
+};
+
+struct DebounceConfiguration {
+	DebounceTimes times[SWITCH_CLASSES];
+
+	// Matrix positions of each class, one word per switch row (other positions are not debounced)
+	uint16_t class_rows[SWITCH_CLASSES][3];
+};
+
+// Parses "<class>=<press_ms>[/<release_ms>]", with class toggle, momentary or encoder
+bool parse_debounce_option(const char *option, DebounceConfiguration &configuration);
+
+// =============================================================
+// SwitchDebouncer: time-based debounce of the 3x12 switch matrix
+// =============================================================
+
+// A position that reads differently from its debounced state becomes pending, and the change
+// is accepted once it has held for the press or release time of its class. Positions that
+// return to the debounced state earlier are counted as bounces. Rows are handled a word at a
+// time, so a sample without pending positions costs a few bitwise operations per row.
+
+class SwitchDebouncer {
+private:
+	uint64_t press_ns[3][12];
+	uint64_t release_ns[3][12];
+
+	uint16_t stable[3];
+	uint16_t pending[3];
+	uint64_t pending_since_ns[3][12];
+
+	bool seeded;
+
+	std::atomic<uint64_t> bounces;
+
+public:
+	SwitchDebouncer();
+
+	void configure(const DebounceConfiguration &configuration);
+
+	// Each row word has bit <col> set when the switch is closed
+	// Returns true when the debounced state changed
+	bool update(const uint16_t raw[3], uint64_t now_ns, uint16_t debounced[3]);
+
+	// When the latest accepted change of a position was first sampled
+	uint64_t get_change_time_ns(int row, int col) const { return pending_since_ns[row][col]; }
+
+	uint64_t get_bounces() const { return bounces.load(std::memory_order_relaxed); }
+};
+
+#endif // DEBOUNCE_H
@@ -0,0 +1,151 @@
+#include "display_rate.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+
+DisplayRateController::DisplayRateController(const DisplayRateConfiguration &configuration, unsigned int sample_depth, const DisplayRate &initial):
+	configuration(configuration),
+	sample_depth{sample_depth},
+	current(initial),
+	cost_average_ns{0},
+	instruction_rate_average{0},
+	last_simulation_time{0},
+	last_simulation_time_ns{0},
+	simulation_time_valid{false},
+	mode{Mode::Running},
+	retune_time_ns{0},
+	retunes{0},
+	interval_sum_us{0},
+	interval_samples{0} {
+}
+
+void DisplayRateController::record_update_cost(uint64_t cost_ns) {
+	// Weight 1/8 for the new cost
+	cost_average_ns = cost_average_ns ? (cost_average_ns * 7 + cost_ns) / 8 : cost_ns;
+}
+
+void DisplayRateController::record_simulation_time(uint64_t simulation_time, uint64_t now_ns) {
+	// Updates arriving back to back say nothing about the rate
+	if(simulation_time_valid && simulation_time == last_simulation_time) {
+		return;
+	}
+
+	// A restarted simulator counts from 0 again, and is measured from there
+	if(simulation_time_valid && simulation_time > last_simulation_time && now_ns > last_simulation_time_ns) {
+		double instruction_rate = (simulation_time - last_simulation_time) * 1e9 / (now_ns - last_simulation_time_ns);
+
+		// Weight 1/8 for the new rate
+		instruction_rate_average = (instruction_rate_average > 0) ? (instruction_rate_average * 7 + instruction_rate) / 8 : instruction_rate;
+	}
+
+	last_simulation_time = simulation_time;
+	last_simulation_time_ns = now_ns;
+	simulation_time_valid = true;
+}
+
+bool DisplayRateController::update(uint64_t frame_period_ns, bool running, bool idle, uint64_t now_ns, DisplayRate &rate) {
+	interval_sum_us += current.interval_us;
+	interval_samples++;
+
+	Mode new_mode = running ? Mode::Running : (idle ? Mode::HaltedIdle : Mode::HaltedActive);
+
+	// The time spent halted is not run time: measure again from the next update
+	if(!running) {
+		simulation_time_valid = false;
+	}
+
+	uint64_t frame_period_us = frame_period_ns / 1000;
+
+	// Nothing to tune against before the scanner measured its first frames
+	if(frame_period_us == 0) {
+		return false;
+	}
+
+	uint64_t interval_us;
+
+	switch(new_mode) {
+		case Mode::Running:
+			interval_us = std::max(frame_period_us, COST_BUDGET * cost_average_ns / 1000);
+			break;
+
+		case Mode::HaltedActive:
+			interval_us = frame_period_us;
+			break;
+
+		case Mode::HaltedIdle:
+		default:
+			interval_us = configuration.max_interval_us;
+			break;
+	}
+
+	interval_us = std::min<uint64_t>(std::max<uint64_t>(interval_us, configuration.min_interval_us), configuration.max_interval_us);
+
+	rate.interval_us = (unsigned int) interval_us;
+
+	// The samples of one update span the instructions run in the interval; nothing is sampled while
+	// halted, and nothing is known before the rate was measured, so the setting is left alone then
+	rate.sample_frequency = current.sample_frequency;
+
+	if(running && instruction_rate_average > 0) {
+		double instructions = instruction_rate_average * interval_us / 1e6;
+
+		rate.sample_frequency = (unsigned int) std::min(std::max(instructions / sample_depth + 0.5, 1.0), (double) UINT_MAX);
+	}
+
+	if(rate.interval_us == current.interval_us && rate.sample_frequency == current.sample_frequency) {
+		mode = new_mode;
+		return false;
+	}
+
+	// Mode changes apply right away, drifts only when large enough and not too often
+	if(new_mode == mode) {
+		auto large_change = [](uint64_t from, uint64_t to) {
+			return ((from > to) ? from - to : to - from) * RETUNE_THRESHOLD >= from;
+		};
+
+		bool large = large_change(current.interval_us, rate.interval_us) || large_change(current.sample_frequency, rate.sample_frequency);
+
+		if(now_ns - retune_time_ns < RETUNE_INTERVAL_NS || !large) {
+			return false;
+		}
+	}
+
+	mode = new_mode;
+	retune_time_ns = now_ns;
+
+	current = rate;
+	retunes++;
+
+	return true;
+}
+
+void DisplayRateController::report_statistics(bool reset) {
+	logger->info("[DISPLAY] Register updates every %.1f ms (avg %.1f ms), PC sampled every %u instructions, %llu retunes\n",
+		current.interval_us / 1e3, interval_samples ? interval_sum_us / 1e3 / interval_samples : current.interval_us / 1e3,
+		current.sample_frequency, (unsigned long long) retunes);
+	logger->info("[DISPLAY] Handling an update takes %.1f us, the guest runs %.2f M instructions/s\n", cost_average_ns / 1e3, instruction_rate_average / 1e6);
+
+	if(reset) {
+		retunes = 0;
+		interval_sum_us = 0;
+		interval_samples = 0;
+	}
+}
+
+// <min_ms>,<max_ms>
+bool parse_update_interval_option(const char *option, DisplayRateConfiguration &configuration) {
+	double min_ms, max_ms;
+	char extra;
+
+	// Written so that NaN fails as well
+	if(sscanf(option, "%lf,%lf%c", &min_ms, &max_ms, &extra) != 2 || !(min_ms * 1000 >= 1) || !(max_ms >= min_ms) || !(max_ms * 1000 <= UINT_MAX)) {
+		return false;
+	}
+
+	configuration.min_interval_us = (unsigned int) (min_ms * 1000);
+	configuration.max_interval_us = (unsigned int) (max_ms * 1000);
+
+	return true;
+}
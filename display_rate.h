@@ -0,0 +1,95 @@
+#ifndef DISPLAY_RATE_H
+#define DISPLAY_RATE_H
+
+#include <cstdint>
+
+// =============================================================
+// Display rate control
+// =============================================================
+
+struct DisplayRateConfiguration {
+	// Bounds of the display callback interval
+	unsigned int min_interval_us;
+	unsigned int max_interval_us;
+};
+
+struct DisplayRate {
+	unsigned int interval_us;
+
+	// Instructions between PC bit samples (the sample depth stays fixed)
+	unsigned int sample_frequency;
+};
+
+// Chooses how often the simulator sends register updates, and how often it samples
+// the PC bits, from the measured LED frame period, the cost of handling an update and
+// the instruction rate of the guest (from the simulation time of the updates):
+// - running (blinkenlights shown): one update per LED frame, unless handling updates
+//   would take more than 1/COST_BUDGET of the time; the samples of one update are
+//   spread over the instructions the guest runs in the interval
+// - halted with recent panel activity: one update per LED frame
+// - halted and idle: the slowest interval
+// Only used by the panel logic thread
+
+class DisplayRateController {
+private:
+	static constexpr unsigned int COST_BUDGET = 20;
+
+	// Small changes are applied at most this often
+	static constexpr uint64_t RETUNE_INTERVAL_NS = 1000000000;
+
+	// Relative change (1/n) below which the rate is left alone
+	static constexpr unsigned int RETUNE_THRESHOLD = 5;
+
+	DisplayRateConfiguration configuration;
+
+	// PC bit samples per update
+	unsigned int sample_depth;
+
+	DisplayRate current;
+
+	// Moving average of the time to handle one register update
+	uint64_t cost_average_ns;
+
+	// Moving average of the guest instructions per second, and the update it is measured from
+	double instruction_rate_average;
+	uint64_t last_simulation_time;
+	uint64_t last_simulation_time_ns;
+	bool simulation_time_valid;
+
+	enum class Mode {
+		Running,
+		HaltedActive,
+		HaltedIdle
+	};
+
+	Mode mode;
+	uint64_t retune_time_ns;
+
+	// Statistics
+	uint64_t retunes;
+	uint64_t interval_sum_us;
+	uint64_t interval_samples;
+
+public:
+	DisplayRateController(const DisplayRateConfiguration &configuration, unsigned int sample_depth, const DisplayRate &initial);
+
+	void record_update_cost(uint64_t cost_ns);
+
+	// Simulation time (instructions) of a register update received while running, and when it arrived
+	void record_simulation_time(uint64_t simulation_time, uint64_t now_ns);
+
+	// Returns true when <rate> differs from the current rate and should be applied
+	bool update(uint64_t frame_period_ns, bool running, bool idle, uint64_t now_ns, DisplayRate &rate);
+
+	const DisplayRate& get_rate() const { return current; }
+
+	// 0 before it was measured
+	double get_instruction_rate() const { return instruction_rate_average; }
+
+	void report_statistics(bool reset);
+};
+
+// <min_ms>,<max_ms>, both at least 1 us
+bool parse_update_interval_option(const char *option, DisplayRateConfiguration &configuration);
+
+#endif // DISPLAY_RATE_H
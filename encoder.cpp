@@ -0,0 +1,73 @@
+#include "encoder.h"
+
+// Indexed by (previous_state << 2) | state, where state = (A << 1) | B
+// Clockwise: 00 -> 01 -> 11 -> 10 -> 00
+const int8_t QuadratureDecoder::TRANSITIONS[16] = {
+	 0, +1, -1,  0,
+	-1,  0,  0, +1,
+	+1,  0,  0, -1,
+	 0, -1, +1,  0
+};
+
+// Both inputs changed: 00 <-> 11, 01 <-> 10
+constexpr uint16_t ILLEGAL_TRANSITIONS = (1u << 0b0011) | (1u << 0b0110) | (1u << 0b1001) | (1u << 0b1100);
+
+QuadratureDecoder::QuadratureDecoder():
+	last_state{0},
+	seeded{false},
+	partial_transitions{0},
+	last_detent_ns{0},
+	acceleration{false},
+	pending_steps{0},
+	detents{0},
+	illegal_transitions{0} {
+}
+
+bool QuadratureDecoder::update(bool a, bool b, uint64_t now_ns) {
+	uint8_t state = (a ? 2 : 0) | (b ? 1 : 0);
+
+	if(!seeded) {
+		last_state = state;
+		seeded = true;
+
+		return false;
+	}
+
+	unsigned int index = (last_state << 2) | state;
+
+	last_state = state;
+
+	if(ILLEGAL_TRANSITIONS & (1u << index)) {
+		illegal_transitions.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	partial_transitions += TRANSITIONS[index];
+
+	if(partial_transitions >= TRANSITIONS_PER_DETENT || partial_transitions <= -TRANSITIONS_PER_DETENT) {
+		int direction = (partial_transitions > 0) ? 1 : -1;
+		int steps = 1;
+
+		partial_transitions = 0;
+
+		if(acceleration && last_detent_ns != 0) {
+			uint64_t interval_ns = now_ns - last_detent_ns;
+
+			if(interval_ns < ACCELERATION_FASTER_NS) {
+				steps = 3;
+			}
+			else if(interval_ns < ACCELERATION_FAST_NS) {
+				steps = 2;
+			}
+		}
+
+		last_detent_ns = now_ns;
+
+		detents.fetch_add(1, std::memory_order_relaxed);
+		pending_steps.fetch_add(direction * steps, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	return false;
+}
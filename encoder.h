@@ -0,0 +1,55 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <atomic>
+#include <cstdint>
+
+// =============================================================
+// QuadratureDecoder: rotary encoder on two switch matrix inputs
+// =============================================================
+
+// Decodes every sampled (A, B) pair through a 16-entry table indexed by the previous and current
+// state. Detents are accumulated atomically, so the panel logic can collect them at its own pace
+// without losing steps. Transitions where both inputs changed between samples are illegal: their
+// direction is unknown, so they only increment a counter.
+
+class QuadratureDecoder {
+private:
+	static constexpr int TRANSITIONS_PER_DETENT = 4;
+
+	// Detents closer than these intervals count two and three steps when accelerating
+	static constexpr uint64_t ACCELERATION_FAST_NS   = 40000000;
+	static constexpr uint64_t ACCELERATION_FASTER_NS = 15000000;
+
+	static const int8_t TRANSITIONS[16];
+
+	uint8_t last_state;
+	bool seeded;
+
+	int partial_transitions;
+	uint64_t last_detent_ns;
+
+	bool acceleration;
+
+	std::atomic<int32_t> pending_steps;
+
+	std::atomic<uint64_t> detents;
+	std::atomic<uint64_t> illegal_transitions;
+
+public:
+	QuadratureDecoder();
+
+	void set_acceleration(bool flag) { acceleration = flag; }
+
+	// Called by the scanner for every sample of the encoder inputs
+	// Returns true when a detent completed
+	bool update(bool a, bool b, uint64_t now_ns);
+
+	// Steps since the previous call (positive is clockwise)
+	int32_t take_steps() { return pending_steps.exchange(0, std::memory_order_relaxed); }
+
+	uint64_t get_detents() const { return detents.load(std::memory_order_relaxed); }
+	uint64_t get_illegal_transitions() const { return illegal_transitions.load(std::memory_order_relaxed); }
+};
+
+#endif // ENCODER_H
@@ -0,0 +1,89 @@
+#include "examine_cache.h"
+#include "logger.h"
+
+#include <iterator>
+
+ExamineCache::ExamineCache():
+	lookups{0},
+	hits{0},
+	fetches{0},
+	stale{0},
+	invalidations{0} {
+}
+
+bool ExamineCache::lookup(uint32_t address, uint16_t &value) {
+	lookups++;
+
+	auto entry = entries.find(address);
+
+	if(entry == entries.end() || !entry->second.valid) {
+		return false;
+	}
+
+	hits++;
+	value = entry->second.value;
+
+	return true;
+}
+
+bool ExamineCache::contains(uint32_t address) const {
+	return entries.count(address) != 0;
+}
+
+void ExamineCache::fetching(uint32_t address, uint64_t command_id) {
+	if(entries.size() >= CAPACITY) {
+		for(auto entry = entries.begin(); entry != entries.end();) {
+			entry = entry->second.valid ? entries.erase(entry) : std::next(entry);
+		}
+	}
+
+	fetches++;
+	entries[address] = Entry{0, command_id, false};
+}
+
+bool ExamineCache::fill(uint32_t address, uint64_t command_id, bool success, uint16_t value) {
+	auto entry = entries.find(address);
+
+	if(entry == entries.end() || entry->second.command_id != command_id) {
+		stale++;
+		return false;
+	}
+
+	if(success) {
+		entry->second = Entry{value, 0, true};
+	}
+	else {
+		entries.erase(entry);
+	}
+
+	return true;
+}
+
+void ExamineCache::invalidate() {
+	if(entries.empty()) {
+		return;
+	}
+
+	invalidations++;
+	entries.clear();
+}
+
+void ExamineCache::report_statistics(bool reset) {
+	if(lookups == 0) {
+		logger->info("[EXAMINE] No EXAMs\n");
+	}
+	else {
+		logger->info("[EXAMINE] %llu EXAMs, %llu served from the cache, %llu examine round trips (%.2f per EXAM)\n",
+			(unsigned long long) lookups, (unsigned long long) hits, (unsigned long long) fetches, (double) fetches / lookups);
+		logger->info("[EXAMINE] Cache invalidated %llu times, %llu stale fetches discarded\n",
+			(unsigned long long) invalidations, (unsigned long long) stale);
+	}
+
+	if(reset) {
+		lookups = 0;
+		hits = 0;
+		fetches = 0;
+		stale = 0;
+		invalidations = 0;
+	}
+}
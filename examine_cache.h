@@ -0,0 +1,60 @@
+#ifndef EXAMINE_CACHE_H
+#define EXAMINE_CACHE_H
+
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+// =============================================================
+// Examine cache
+// =============================================================
+
+// Memory words examined ahead of the console address, so that EXAM sequences are
+// served locally; the fetches themselves are simulator commands issued by the caller
+// Only used by the panel logic thread
+
+class ExamineCache {
+public:
+	// Examined words are dropped when it grows past this, a LOAD ADDR sequence can leave many
+	// blocks behind; words still being fetched are kept, their EXAM may be waiting for them
+	static constexpr size_t CAPACITY = 4096;
+
+private:
+	struct Entry {
+		uint16_t value;
+
+		// Command fetching the word (0 once it arrived)
+		uint64_t command_id;
+
+		bool valid;
+	};
+
+	std::unordered_map<uint32_t, Entry> entries;
+
+	// Statistics
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t fetches;
+	uint64_t stale;
+	uint64_t invalidations;
+
+public:
+	ExamineCache();
+
+	// One call per EXAM, counts towards the hit rate
+	bool lookup(uint32_t address, uint16_t &value);
+
+	// Valid or being fetched
+	bool contains(uint32_t address) const;
+
+	void fetching(uint32_t address, uint64_t command_id);
+
+	// Returns false for results of fetches issued before an invalidation (which are discarded)
+	bool fill(uint32_t address, uint64_t command_id, bool success, uint16_t value);
+
+	void invalidate();
+
+	void report_statistics(bool reset);
+};
+
+#endif // EXAMINE_CACHE_H
@@ -3,6 +3,19 @@ extern "C" {
 }
 
 #include "gpio.h"
+#include "gpio_gpiod.h"
+#include "gpio_simulated.h"
+#include "gpio_mmap.h"
+#include "scanner.h"
+#include "simulator_commands.h"
+#include "examine_cache.h"
+#include "memory_image.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "simulator_process.h"
+#include "register_subscriptions.h"
+#include "display_rate.h"
+#include "timing.h"
 #include "configuration.h"
 #include "logger.h"
 #include "daemon.h"
@@ -10,13 +23,19 @@ extern "C" {
 #include <unistd.h>
 #include <time.h>
 #include <getopt.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
+#include <cerrno>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <csignal>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 
 using std::vector;
 
@@ -24,13 +43,53 @@ using std::vector;
 // Timing constants
 // =============================================================
 
-constexpr unsigned int WAIT_SIGNAL_LED_SETTLE_NS      = 1500000;
-constexpr unsigned int WAIT_SIGNAL_LED_BLANKING_NS    = 100000;
-constexpr unsigned int WAIT_SIGNAL_SWITCH_SETTLE_NS   = 50000;
-constexpr unsigned int WAIT_MODE_CHANGE_US            = 10;
 constexpr unsigned int WAIT_POLL_INTERVAL_MS          = 50;
-constexpr unsigned int WAIT_LOOP_INTERVAL_NS          = 1000;
 constexpr unsigned int WAIT_CONFIG_SELECTION_S        = 10;
+
+constexpr unsigned int WAIT_FIRST_SCAN_MS             = 1000;
+
+constexpr unsigned int SIMULATED_SWITCH_SETTLE_NS     = 20000;
+
+constexpr unsigned int DEFAULT_FRAME_RATE             = 100;
+
+// Press/release times per switch class, and the matrix positions of each class
+// (see decode_state_switches() and decode_state_rotary_switches())
+// Toggles: SR0-SR21, ENABLE/HALT, S_INST/S_BC
+// Momentaries: TEST, LOAD ADDR, EXAM, DEP, CONT, START, encoder buttons
+// Encoder pins: R1 and R2 rotation (the quadrature decoder tolerates bounce)
+// Switch register rows are refreshed slowly, row 1 also holds the encoder buttons,
+// row 2 (control switches and encoder rotation) is read whenever no other row is due
+static const ScanPolicyConfiguration DEFAULT_SCAN_RATES = {{25, 100, 0}};
+
+static const DebounceConfiguration DEFAULT_DEBOUNCE = {
+	{{20000, 20000}, {5000, 10000}, {0, 0}},
+	{{0xFFF, 0x3FF, 0x060}, {0x000, 0xC00, 0x09F}, {0x000, 0x000, 0xF00}}
+};
+
+// Samples accumulated per bit for the blinkenlights (the counts in bits_pc go up to this)
+constexpr unsigned int BLINKENLIGHT_SAMPLE_DEPTH      = 100;
+
+// Register updates from the simulator until the first measurements, and the bounds the
+// interval is then tuned within (see DisplayRateController)
+constexpr unsigned int REGISTER_UPDATE_INTERVAL_US    = 10000;
+
+static const DisplayRateConfiguration DEFAULT_UPDATE_INTERVALS = {5000, 500000};
+
+// Activity that keeps the fast updates after the simulator halted
+constexpr uint64_t REGISTER_UPDATE_HOLD_NS            = 1000000000;
+
+// Seconds between profile writes
+constexpr unsigned int DEFAULT_PROFILE_INTERVAL_S     = 10;
+
+// Words kept examined from the console address on, during EXAM sequences
+constexpr unsigned int DEFAULT_EXAMINE_BLOCK_WORDS    = 8;
+constexpr unsigned int MAX_EXAMINE_BLOCK_WORDS        = 256;
+
+// Many blocks in flight still leave room for the examined words
+static_assert(MAX_EXAMINE_BLOCK_WORDS * 4 <= ExamineCache::CAPACITY, "examine block too large for the cache");
+
+// Never examined ahead: reading device registers can have side effects
+constexpr uint32_t IO_PAGE_START                      = 017760000;
  
 // =============================================================
 // Pin definitions
@@ -51,6 +110,14 @@ static void signal_handler(int signal_number) {
 	program_running = false;
 }
 
+// SIGUSR1: save a snapshot of the running session
+static volatile sig_atomic_t snapshot_requested = 0;
+
+static void snapshot_signal_handler(int signal_number) {
+	(void) signal_number;
+	snapshot_requested = 1;
+}
+
 // =============================================================
 // Panel state
 // =============================================================
@@ -128,8 +195,65 @@ static uint8_t  reg_id_mode;
 // Bit sampling arrays for blinkenlights (accumulated bit activity)
 static int bits_pc[22] = {0};
 
-// Callback synchronization
-static volatile bool registers_updated = false;
+// Callback synchronization: the flag says what happened, the eventfd wakes the main loop
+static std::atomic<bool> registers_updated{false};
+
+// Simulation time (instructions) of the latest update, and when it arrived
+static std::atomic<uint64_t> update_simulation_time{0};
+static std::atomic<uint64_t> update_time_ns{0};
+static int register_event_fd = -1;
+
+static unsigned int examine_block_words = DEFAULT_EXAMINE_BLOCK_WORDS;
+
+// Deposited instead of booting, when given
+static MemoryImage *memory_image = nullptr;
+static bool verify_memory_image = false;
+
+// Samples the PC with every register update while the simulator runs, when given
+static PCProfiler *profiler = nullptr;
+
+static SnapshotStore *snapshots = nullptr;
+
+static DisplayRateConfiguration display_rate_configuration = DEFAULT_UPDATE_INTERVALS;
+
+// The simulator of a session that ends with R1/R2 stays connected, and a later session reuses it
+// when it runs the same configuration:
+// - with --warm-restart, halted and rebooted by the next session
+// - with --instances, left running in the background and attached again as it is (R2 reboots it)
+struct KeptSimulator {
+	PANEL *panel;
+	SimulatorProcess process;
+
+	string binary_path;
+	string directory;
+	string configuration_file;
+	uint32_t switch_code;
+
+	// Registers it already ships (RegisterBit)
+	uint32_t registers;
+
+	bool background;
+
+	// Guest run time, as the session that detached it knew it
+	uint64_t first_instruction_ns;
+	double restored_guest_time_s;
+
+	uint64_t detached_ns;
+};
+
+static bool warm_restart = false;
+
+// Simulators kept at most, the attached one included
+static unsigned int simulator_instances = 1;
+
+static vector<KeptSimulator> kept_simulators;
+
+// Affinity of the simulator processes (--simulator-cpus, or all CPUs but the one of the scanner)
+static cpu_set_t simulator_cpus;
+static bool use_simulator_cpus = false;
+
+// When the current session was asked for (start, R1/R2 or a new configuration selection)
+static uint64_t session_request_ns = 0;
 
 // =============================================================
 // Edge detector
@@ -156,50 +280,133 @@ struct Edge {
 };
 
 // =============================================================
-// Rotary encoder
+// Switch-to-action latency
 // =============================================================
 
-struct RotaryEncoder {
-	static constexpr int SENSITIVITY = 4;
+// Time from the first sample of a control switch change to the end of the simulator action
+struct ActionLatency {
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t max_ns;
 
-	uint8_t states;
-	uint8_t last_state;
-	int8_t accumulated_deltas;
-	uint8_t position;
+	ActionLatency(): count{0}, sum_ns{0}, max_ns{0} {}
+
+	void record(uint64_t latency_ns) {
+		count++;
+		sum_ns += latency_ns;
+
+		if(latency_ns > max_ns) {
+			max_ns = latency_ns;
+		}
+	}
+
+	void report(bool reset) {
+		if(count == 0) {
+			logger->info("[LATENCY] No control switch actions\n");
+		}
+		else {
+			logger->info("[LATENCY] %llu control switch actions, switch-to-action avg/max: %.2f/%.2f ms\n",
+				(unsigned long long) count, sum_ns / 1e6 / count, max_ns / 1e6);
+		}
+
+		if(reset) {
+			*this = ActionLatency();
+		}
+	}
+};
+
+// =============================================================
+// CPU usage
+// =============================================================
+
+static uint64_t cpu_time_ns(clockid_t clock) {
+	struct timespec now;
+
+	clock_gettime(clock, &now);
+
+	return (uint64_t) now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+// CPU time of the main loop thread and of the whole process (scanner included),
+// split by whether the simulator was halted or running
+struct CpuUsage {
+	struct Totals {
+		uint64_t wall_ns;
+		uint64_t thread_ns;
+		uint64_t process_ns;
+	};
+
+	Totals totals[2];
+
+	bool running;
+
+	uint64_t last_wall_ns;
+	uint64_t last_thread_ns;
+	uint64_t last_process_ns;
 
-	RotaryEncoder(uint8_t states): states{states}, last_state{0}, accumulated_deltas{0}, position{0} {}
+	CpuUsage(): totals{}, running{false} {
+		last_wall_ns = monotonic_time_ns();
+		last_thread_ns = cpu_time_ns(CLOCK_THREAD_CPUTIME_ID);
+		last_process_ns = cpu_time_ns(CLOCK_PROCESS_CPUTIME_ID);
+	}
+
+	void accumulate() {
+		uint64_t wall_ns = monotonic_time_ns();
+		uint64_t thread_ns = cpu_time_ns(CLOCK_THREAD_CPUTIME_ID);
+		uint64_t process_ns = cpu_time_ns(CLOCK_PROCESS_CPUTIME_ID);
 
-	void add_delta(bool a, bool b) {
-		uint8_t state = (a ? 2 : 0) | (b ? 1 : 0);
-		int delta = 0;
+		totals[running].wall_ns += wall_ns - last_wall_ns;
+		totals[running].thread_ns += thread_ns - last_thread_ns;
+		totals[running].process_ns += process_ns - last_process_ns;
+
+		last_wall_ns = wall_ns;
+		last_thread_ns = thread_ns;
+		last_process_ns = process_ns;
+	}
 
-		// Clockwise transitions
-		if(last_state == 0b00 && state == 0b01) delta = +1;
-		else if(last_state == 0b01 && state == 0b11) delta = +1;
-		else if(last_state == 0b11 && state == 0b10) delta = +1;
-		else if(last_state == 0b10 && state == 0b00) delta = +1;
+	void update(bool simulator_running) {
+		if(simulator_running != running) {
+			accumulate();
+			running = simulator_running;
+		}
+	}
 
-		// Counter-clockwise transitions
-		else if(last_state == 0b00 && state == 0b10) delta = -1;
-		else if(last_state == 0b10 && state == 0b11) delta = -1;
-		else if(last_state == 0b11 && state == 0b01) delta = -1;
-		else if(last_state == 0b01 && state == 0b00) delta = -1;
+	void report(bool reset) {
+		static const char *state_names[2] = {"halted", "running"};
 
-		accumulated_deltas += delta;
+		accumulate();
 
-		last_state = state;
+		for(int state = 0; state < 2; state++) {
+			if(totals[state].wall_ns == 0) {
+				continue;
+			}
 
-		if(accumulated_deltas > SENSITIVITY) {
-			accumulated_deltas = 0;
-			position++;
+			logger->info("[CPU] Simulator %s for %.1f s: main loop %.1f%%, frontpanel process %.1f%% of one core\n",
+				state_names[state], totals[state].wall_ns / 1e9,
+				100.0 * totals[state].thread_ns / totals[state].wall_ns,
+				100.0 * totals[state].process_ns / totals[state].wall_ns);
 		}
 
-		if(accumulated_deltas < -SENSITIVITY) {
-			accumulated_deltas = 0;
-			position--;
+		if(reset) {
+			totals[0] = Totals{};
+			totals[1] = Totals{};
 		}
+	}
+};
+
+// =============================================================
+// Rotary encoder
+// =============================================================
+
+// Steps are decoded from the quadrature inputs by the scanner thread
+struct RotaryEncoder {
+	uint8_t states;
+	uint8_t position;
+
+	RotaryEncoder(uint8_t states): states{states}, position{0} {}
 
-		position %= states;
+	void add_steps(int steps) {
+		position = (uint8_t) (((position + steps) % states + states) % states);
 	}
 };
 
@@ -207,63 +414,86 @@ struct RotaryEncoder {
 // GPIO objects
 // =============================================================
 
-static GPIOChip *chip = nullptr;
-static GPIOGroup *led_rows = nullptr;
-static GPIOGroup *switch_rows = nullptr;
-static GPIOGroup *cols = nullptr;
+static GPIOBackend *gpio_backend = nullptr;
+static GPIOGroup *matrix = nullptr;
+static PanelScanner *scanner = nullptr;
 
 // =============================================================
 // GPIO initialization
 // =============================================================
 
-static void init_gpio() {
-	chip = new GPIOChip("/dev/gpiochip0");
-	chip->init();
+static GPIOBackend* create_gpio_backend(const char *backend_name, const char *memory_path) {
+	if(strcmp(backend_name, "gpiod") == 0) {
+		return new GPIOChip("/dev/gpiochip0");
+	}
 
-    // Led pins off
-	vector<unsigned int> led_row_pins;
+	if(strcmp(backend_name, "mmap") == 0) {
+		return new GPIOMemory(memory_path);
+	}
 
-	for(int i = 0; i < 6; i++) {
-		led_row_pins.push_back(LED_ROWS[i]);
+	if(strcmp(backend_name, "simulated") == 0) {
+		return new SimulatedPanel(vector<unsigned int>(LED_ROWS, LED_ROWS + 6),
+			vector<unsigned int>(SWITCH_ROWS, SWITCH_ROWS + 3),
+			vector<unsigned int>(COLS, COLS + 12),
+			SIMULATED_SWITCH_SETTLE_NS);
 	}
 
-	led_rows = new GPIOGroup(chip, led_row_pins);
-	led_rows->init();
-	led_rows->pin_mode(PinMode::Output);
+	return nullptr;
+}
+
+static bool init_gpio(const char *backend_name, const char *memory_path, const ScannerConfiguration &scanner_configuration) {
+	gpio_backend = create_gpio_backend(backend_name, memory_path);
 
-	for(int i = 0; i < 6; i++) {
-		led_rows->pin_set(i, false);
+	if(!gpio_backend) {
+		logger->error("[GPIO] Unknown backend: %s\n", backend_name);
+		return false;
 	}
 
-    // Row pins as sink
-	vector<unsigned int> switch_row_pins;
+	if(!gpio_backend->init()) {
+		logger->error("[GPIO] Failed to initialize %s backend\n", gpio_backend->get_name());
 
-	for(int i = 0; i < 3; i++) {
-		switch_row_pins.push_back(SWITCH_ROWS[i]);
-	}
+		// Register access is an optimization: fall back to the kernel interface
+		if(strcmp(backend_name, "mmap") != 0) {
+			return false;
+		}
 
-	switch_rows = new GPIOGroup(chip, switch_row_pins);
-	switch_rows->init();
-	switch_rows->pin_mode(PinMode::Output);
+		logger->info("[GPIO] Falling back to gpiod backend\n");
 
-	for(int i = 0; i < 3; i++) {
-		switch_rows->pin_set(i, true);
+		delete gpio_backend;
+		gpio_backend = create_gpio_backend("gpiod", memory_path);
+
+		if(!gpio_backend->init()) {
+			logger->error("[GPIO] Failed to initialize %s backend\n", gpio_backend->get_name());
+			return false;
+		}
 	}
 
-    // Column pins off (high)
-	vector<unsigned int> col_pins;
+	logger->info("[GPIO] Using %s backend\n", gpio_backend->get_name());
+
+	vector<unsigned int> matrix_pins;
+
+	matrix_pins.insert(matrix_pins.end(), LED_ROWS, LED_ROWS + 6);
+	matrix_pins.insert(matrix_pins.end(), SWITCH_ROWS, SWITCH_ROWS + 3);
+	matrix_pins.insert(matrix_pins.end(), COLS, COLS + 12);
 
-	for(int i = 0; i < 12; i++) {
-		col_pins.push_back(COLS[i]);
+	matrix = gpio_backend->create_group(matrix_pins);
+
+	if(!matrix->init() || !matrix->pin_mode(PinMode::Output)) {
+		logger->error("[GPIO] Failed to request the panel pins\n");
+		return false;
 	}
 
-	cols = new GPIOGroup(chip, col_pins);
-	cols->init();
-	cols->pin_mode(PinMode::Output);
+	precision_timer = new PrecisionTimer();
+	precision_timer->init();
+
+	scanner = new PanelScanner(matrix, scanner_configuration);
 
-	for(int i = 0; i < 12; i++) {
-		cols->pin_set(i, true);
+	if(!scanner->init()) {
+		logger->error("[GPIO] Failed to initialize the panel scanner\n");
+		return false;
 	}
+
+	return true;
 }
 
 // =============================================================
@@ -271,141 +501,89 @@ static void init_gpio() {
 // =============================================================
 
 static void finish_gpio() {
-	if(led_rows) {
-		for(int i = 0; i < 6; i++) {
-			led_rows->pin_set(i, false);
-		}
-
-		led_rows->finish();
-		delete led_rows;
+	if(scanner) {
+		scanner->finish();
+		delete scanner;
+		scanner = nullptr;
 	}
 
-	if(switch_rows) {
-		for(int i = 0; i < 3; i++) {
-			switch_rows->pin_set(i, true);
-		}
-
-		switch_rows->finish();
-		delete switch_rows;
+	if(precision_timer) {
+		precision_timer->finish();
+		delete precision_timer;
+		precision_timer = nullptr;
 	}
 
-	if(cols) {
-		cols->finish();
-		delete cols;
+	if(matrix) {
+		// Led pins off, switch rows off (high)
+		matrix->pins_set_mask(MATRIX_SWITCH_ROWS | MATRIX_COLS);
+
+		matrix->finish();
+		delete matrix;
+		matrix = nullptr;
 	}
 
-	if(chip) {
-		chip->finish();
-		delete chip;
+	if(gpio_backend) {
+		gpio_backend->finish();
+		delete gpio_backend;
+		gpio_backend = nullptr;
 	}
 }
 
 // =============================================================
-// Read switch state
+// Cleanup
 // =============================================================
 
-static void read_state_switches(bool switches[3][12]) {
-	cols->pin_mode(PinMode::Input, PullMode::PullUp);
-
-	bool sw_row_values[3];
-	bool col_values[12];
-
-	struct timespec time_specification = {0, WAIT_SIGNAL_SWITCH_SETTLE_NS};
-
-	// Deactivate all switch rows (high)
-	for(int i = 0; i < 3; i++) {
-		sw_row_values[i] = true;
-	}
-
-	for(int switch_row = 0; switch_row < 3; switch_row++) {
-		sw_row_values[switch_row] = false;
-		switch_rows->pins_set_all(sw_row_values);
-
-		// Wait for signals to settle
-		nanosleep(&time_specification, nullptr);
-
-		// Read all columns
-		cols->pins_get_all(col_values);
-		for(int col = 0; col < 12; col++) {
-			// Switch pressed: column reads low
-			switches[switch_row][col] = !col_values[col];
-		}
-
-		sw_row_values[switch_row] = true;
-	}
-
-	// Deactivate all switch rows (high)
-	for(int i = 0; i < 3; i++) {
-		sw_row_values[i] = true;
-	}
-	switch_rows->pins_set_all(sw_row_values);
+// Everything main() creates besides the logger, on every exit path
+static void finish_frontpanel() {
+	finish_gpio();
 
-	// Avoids changing pin modes too quickly
-	usleep(WAIT_MODE_CHANGE_US);
+	delete memory_image;
+	memory_image = nullptr;
 
-	// Set all columns back to output mode (high)
-	cols->pin_mode(PinMode::Output);
+	// Stops the writer thread and writes the final profile
+	delete profiler;
+	profiler = nullptr;
 
-	for(int col = 0; col < 12; col++) {
-		col_values[col] = true;
-	}
-	cols->pins_set_all(col_values);
+	delete snapshots;
+	snapshots = nullptr;
 }
 
 // =============================================================
 // Decode switch state
 // =============================================================
 
-static void decode_state_switches(const bool switches[3][12], PanelState &panel_state) {
-	panel_state.switch_state = 0;
-
+static void decode_state_switches(const uint16_t switches[3], PanelState &panel_state) {
 	// Row 0: SR0...SR11
-	for(int col = 0; col < 12; col++) {
-		if(switches[0][col]) {
-			panel_state.switch_state |= (1u << col);
-		}
-	}
-
 	// Row 1: SR12...SR21
-	for(int col = 0; col < 10; col++) {
-		if(switches[1][col]) {
-			panel_state.switch_state |= (1u << (12 + col));
-		}
-	}
+	panel_state.switch_state = (switches[0] & 0xFFF) | ((uint32_t) (switches[1] & 0x3FF) << 12);
 
 	// Row 2: Control switches
-	panel_state.flag_test = !switches[2][0];
-	panel_state.flag_load_addr = !switches[2][1];
-	panel_state.flag_exam = !switches[2][2];
-	panel_state.flag_dep = !switches[2][3];
-	panel_state.flag_cont = !switches[2][4];
-	panel_state.flag_enable_halt = !switches[2][5];
-	panel_state.flag_sinst_sbus_cycle = !switches[2][6];
-	panel_state.flag_start = !switches[2][7];
+	panel_state.flag_test = !(switches[2] & (1u << 0));
+	panel_state.flag_load_addr = !(switches[2] & (1u << 1));
+	panel_state.flag_exam = !(switches[2] & (1u << 2));
+	panel_state.flag_dep = !(switches[2] & (1u << 3));
+	panel_state.flag_cont = !(switches[2] & (1u << 4));
+	panel_state.flag_enable_halt = !(switches[2] & (1u << 5));
+	panel_state.flag_sinst_sbus_cycle = !(switches[2] & (1u << 6));
+	panel_state.flag_start = !(switches[2] & (1u << 7));
 }
 
 // =============================================================
 // Decode rotary switch state
 // =============================================================
 
-static void decode_state_rotary_switches(const bool switches[3][12], PanelState &panel_state, RotaryEncoder &r1_encoder, RotaryEncoder &r2_encoder) {
-	// R1 encoder: row1/col10 (button), row2/col8 and row2/col9 (rotation)
-	panel_state.r1_button = switches[1][10];
+static void decode_state_rotary_switches(const uint16_t switches[3], PanelState &panel_state, RotaryEncoder &r1_encoder, RotaryEncoder &r2_encoder) {
+	// R1 encoder: row1/col10 (button), row2/col8 and row2/col9 (rotation, encoder 0 of the scanner)
+	panel_state.r1_button = (switches[1] >> 10) & 1;
 
-	bool r1_a = switches[2][8];
-	bool r1_b = switches[2][9];
-
-	r1_encoder.add_delta(r1_a, r1_b);
+	r1_encoder.add_steps(scanner->take_encoder_steps(0));
 
 	panel_state.r1_position = r1_encoder.position;
 
-	// R2 encoder: row1/col11 (button), row2/col10 and row2/col11 (rotation)
-	panel_state.r2_button = switches[1][11];
-
-	bool r2_a = switches[2][10];
-	bool r2_b = switches[2][11];
+	// R2 encoder: row1/col11 (button), row2/col10 and row2/col11 (rotation, encoder 1 of the scanner)
+	panel_state.r2_button = (switches[1] >> 11) & 1;
 
-	r2_encoder.add_delta(r2_a, r2_b);
+	r2_encoder.add_steps(scanner->take_encoder_steps(1));
 
 	panel_state.r2_position = r2_encoder.position;
 }
@@ -414,126 +592,98 @@ static void decode_state_rotary_switches(const bool switches[3][12], PanelState
 // Encode light state
 // =============================================================
 
-static void encode_state_lights(const PanelState &panel_state, bool leds[6][12], int *blinkenlight_array) {
-	// Clear all LEDs
-	for(int led_row = 0; led_row < 6; led_row++) {
-		for(int col = 0; col < 12; col++) {
-			leds[led_row][col] = false;
-		}
-	}
+// Compares only the fields encode_state_lights() displays
+static bool same_state_lights(const PanelState &a, const PanelState &b) {
+	return a.address == b.address &&
+		a.data == b.data &&
+		a.flag_addr22 == b.flag_addr22 &&
+		a.flag_addr18 == b.flag_addr18 &&
+		a.flag_addr16 == b.flag_addr16 &&
+		a.flag_data == b.flag_data &&
+		a.flag_kernel == b.flag_kernel &&
+		a.flag_super == b.flag_super &&
+		a.flag_user == b.flag_user &&
+		a.flag_master == b.flag_master &&
+		a.flag_pause == b.flag_pause &&
+		a.flag_run == b.flag_run &&
+		a.flag_addr_err == b.flag_addr_err &&
+		a.flag_par_err == b.flag_par_err &&
+		a.flag_par_low == b.flag_par_low &&
+		a.flag_par_high == b.flag_par_high &&
+		a.r1_position == b.r1_position &&
+		a.r2_position == b.r2_position;
+}
 
-	// LED Row 0: A0...A11
-	// Use blinkenlights (bit sampling) when array provided, otherwise direct address
-	for(int col = 0; col < 12; col++) {
-		if(blinkenlight_array != nullptr) {
-			leds[0][col] = (blinkenlight_array[col] > 50);
-		}
-		else {
-			leds[0][col] = (panel_state.address >> col) & 1;
-		}
-	}
+static void encode_state_lights(const PanelState &panel_state, LEDFrame &frame, int *blinkenlight_array) {
+	uint16_t leds[6];
 
+	// LED Row 0: A0...A11
 	// LED Row 1: A12...A21
-	for(int col = 0; col < 10; col++) {
-		if(blinkenlight_array != nullptr) {
-			leds[1][col] = (blinkenlight_array[12 + col] > 50);
-		}
-		else {
-			leds[1][col] = (panel_state.address >> (12 + col)) & 1;
-		}
+	// Blinkenlights (bit sampling) are added as brightness levels below, otherwise direct address
+	if(blinkenlight_array != nullptr) {
+		leds[0] = 0;
+		leds[1] = 0;
+	}
+	else {
+		leds[0] = panel_state.address & 0xFFF;
+		leds[1] = (panel_state.address >> 12) & 0x3FF;
 	}
 
 	// LED Row 2: Status indicators
-	leds[2][0] = panel_state.flag_addr22;
-	leds[2][1] = panel_state.flag_addr18;
-	leds[2][2] = panel_state.flag_addr16;
-	leds[2][3] = panel_state.flag_data;
-	leds[2][4] = panel_state.flag_kernel;
-	leds[2][5] = panel_state.flag_super;
-	leds[2][6] = panel_state.flag_user;
-	leds[2][7] = panel_state.flag_master;
-	leds[2][8] = panel_state.flag_pause;
-	leds[2][9] = panel_state.flag_run;
-	leds[2][10] = panel_state.flag_addr_err;
-	leds[2][11] = panel_state.flag_par_err;
+	leds[2] = (panel_state.flag_addr22 << 0) |
+		(panel_state.flag_addr18 << 1) |
+		(panel_state.flag_addr16 << 2) |
+		(panel_state.flag_data << 3) |
+		(panel_state.flag_kernel << 4) |
+		(panel_state.flag_super << 5) |
+		(panel_state.flag_user << 6) |
+		(panel_state.flag_master << 7) |
+		(panel_state.flag_pause << 8) |
+		(panel_state.flag_run << 9) |
+		(panel_state.flag_addr_err << 10) |
+		(panel_state.flag_par_err << 11);
 
 	// LED Row 3: D0...D11
-	for(int col = 0; col < 12; col++) {
-		leds[3][col] = (panel_state.data >> col) & 1;
-	}
+	leds[3] = panel_state.data & 0xFFF;
 
 	// LED Row 4: D12...D15, PAR_LOW, PAR_HIGH, R1 positions 0-3, R2 positions 0-1
-	leds[4][0] = (panel_state.data >> 12) & 1;
-	leds[4][1] = (panel_state.data >> 13) & 1;
-	leds[4][2] = (panel_state.data >> 14) & 1;
-	leds[4][3] = (panel_state.data >> 15) & 1;
-	leds[4][4] = panel_state.flag_par_low;
-	leds[4][5] = panel_state.flag_par_high;
-
-	// R1 positions: USER_D, SUPER_D, KERNEL_D, CONS_PHY (row 4, cols 6-9)
-	if(panel_state.r1_position == 0) leds[4][6] = true;  // USER_D
-	if(panel_state.r1_position == 1) leds[4][7] = true;  // SUPER_D
-	if(panel_state.r1_position == 2) leds[4][8] = true;  // KERNEL_D
-	if(panel_state.r1_position == 3) leds[4][9] = true;  // CONS_PHY
+	leds[4] = ((panel_state.data >> 12) & 0xF) |
+		(panel_state.flag_par_low << 4) |
+		(panel_state.flag_par_high << 5);
 
 	// LED Row 5: R1 positions 4-7, R2 positions 2-3
+	leds[5] = 0;
+
+	// R1 positions: USER_D, SUPER_D, KERNEL_D, CONS_PHY (row 4, cols 6-9)
 	// R1 positions: USER_I, SUPER_I, KERNEL_I, PROG_PHY (row 5, cols 6-9)
-	if(panel_state.r1_position == 4) leds[5][6] = true;  // USER_I
-	if(panel_state.r1_position == 5) leds[5][7] = true;  // SUPER_I
-	if(panel_state.r1_position == 6) leds[5][8] = true;  // KERNEL_I
-	if(panel_state.r1_position == 7) leds[5][9] = true;  // PROG_PHY
+	if(panel_state.r1_position < 4) {
+		leds[4] |= (1u << (6 + panel_state.r1_position));
+	}
+	else {
+		leds[5] |= (1u << (6 + panel_state.r1_position - 4));
+	}
 
 	// R2 positions: DATA_PATHS, BUS_REG (row 4, cols 10-11)
-	if(panel_state.r2_position == 0) leds[4][10] = true;  // DATA_PATHS
-	if(panel_state.r2_position == 1) leds[4][11] = true;  // BUS_REG
-
 	// R2 positions: MU_ADR_FPP_CPU, DISPLAY_REGISTER (row 5, cols 10-11)
-	if(panel_state.r2_position == 2) leds[5][10] = true;  // MU_ADR_FPP_CPU
-	if(panel_state.r2_position == 3) leds[5][11] = true;  // DISPLAY_REGISTER
-}
-
-// =============================================================
-// Write light state
-// =============================================================
-
-static void write_state_lights(const bool leds[6][12]) {
-	bool row_values[6];
-	bool col_values[12];
-
-	struct timespec led_settle_time = {0, WAIT_SIGNAL_LED_SETTLE_NS};
-	struct timespec blanking_time = {0, WAIT_SIGNAL_LED_BLANKING_NS};
-
-	// Turn off all rows in the beginning
-	for(int i = 0; i < 6; i++) {
-		row_values[i] = false;
+	if(panel_state.r2_position < 2) {
+		leds[4] |= (1u << (10 + panel_state.r2_position));
+	}
+	else {
+		leds[5] |= (1u << (10 + panel_state.r2_position - 2));
 	}
-	led_rows->pins_set_all(row_values);
 
 	for(int led_row = 0; led_row < 6; led_row++) {
-		// Set columns for this row
-		for(int col = 0; col < 12; col++) {
-			col_values[col] = !leds[led_row][col];
-		}
-		cols->pins_set_all(col_values);
-
-		// Wait for signals to settle before turning on row
-		nanosleep(&blanking_time, nullptr);
-
-		// Turn on this row
-		led_rows->pin_set(led_row, true);
-
-		// Keep it on for visibility
-		nanosleep(&led_settle_time, nullptr);
-
-		// Turn off this row
-		led_rows->pin_set(led_row, false);
+		frame.set_row(led_row, leds[led_row]);
 	}
 
-	// Turn off all columns at the end
-	for(int col = 0; col < 12; col++) {
-		col_values[col] = true;
+	// Each address lamp glows in proportion to how often its bit was set in the samples
+	if(blinkenlight_array != nullptr) {
+		for(int bit = 0; bit < 22; bit++) {
+			unsigned int level = (unsigned int) (blinkenlight_array[bit] * LED_BRIGHTNESS_MAX + BLINKENLIGHT_SAMPLE_DEPTH / 2) / BLINKENLIGHT_SAMPLE_DEPTH;
+
+			frame.set_level(bit / 12, bit % 12, std::min(level, LED_BRIGHTNESS_MAX));
+		}
 	}
-	cols->pins_set_all(col_values);
 }
 
 // =============================================================
@@ -615,6 +765,54 @@ static uint32_t select_display_address_paused(uint8_t r1_pos, uint32_t console_a
 	return 0;
 }
 
+// Bits of the registers in the subscription masks, in the order run_session() defines them
+enum RegisterBit : uint32_t {
+	REGISTER_PC     = 1u << 0,
+	REGISTER_PSW    = 1u << 1,
+	REGISTER_MMR0   = 1u << 2,
+	REGISTER_MMR3   = 1u << 3,
+	REGISTER_IDMODE = 1u << 4,
+	REGISTER_IR     = 1u << 5,
+	// R0-R5, SP
+	REGISTER_R0     = 1u << 6
+};
+
+// Lamps that are always shown: address (PC), mode (PSW), address width (MMR0, MMR3), data (IDMODE)
+constexpr uint32_t REGISTERS_ALWAYS = REGISTER_PC | REGISTER_PSW | REGISTER_MMR0 | REGISTER_MMR3 | REGISTER_IDMODE;
+
+// Registers the DATA lamps read in the current R2 position and run state
+static uint32_t required_registers(const PanelState &panel_state, bool running) {
+	uint32_t required = REGISTERS_ALWAYS;
+
+	switch(panel_state.r2_position) {
+		case 0: // DATA_PATHS: R0 when halted
+			if(!running) {
+				required |= REGISTER_R0;
+			}
+
+			break;
+
+		case 1: // BUS_REG: IR when running
+			if(running) {
+				required |= REGISTER_IR;
+			}
+
+			break;
+
+		case 3: { // DISPLAY_REGISTER: register selected by SR[2:0]
+			uint32_t index = panel_state.switch_state & 0x7;
+
+			if(index != 7) {
+				required |= (REGISTER_R0 << index);
+			}
+
+			break;
+		}
+	}
+
+	return required;
+}
+
 static uint16_t select_display_register_data(uint32_t switch_state) {
 	// Use switch register bits [2:0] to select R0-R7
 	uint32_t index = switch_state & 0x7;
@@ -628,114 +826,749 @@ static uint16_t select_display_register_data(uint32_t switch_state) {
 }
 
 // =============================================================
-// Display callback for register updates
+// Switch events
 // =============================================================
 
-static void display_callback(PANEL *panel, unsigned long long simulation_time, void *context) {
-	(void) panel;
-	(void) simulation_time;
-	(void) context;
+// Sample sequence numbers are 28 bits wide
+static bool sequence_after(uint32_t sequence, uint32_t reference) {
+	return (int32_t) ((sequence - reference) << 4) > 0;
+}
 
-	// Registers are automatically updated in their buffers
-	// Just signal that new data is available
-	registers_updated = true;
+// Applies the next switch event that is not yet part of <switches>; <sequence> is the sample
+// the switch state is known to include. Resynchronizes from the latest sample if events were lost.
+static bool next_switch_event(uint16_t switches[3], uint32_t &sequence, uint64_t &dropped_events, SwitchEvent &event) {
+	if(scanner->get_dropped_switch_events() != dropped_events) {
+		dropped_events = scanner->get_dropped_switch_events();
+		sequence = scanner->get_switches(switches);
+
+		logger->error("[EVENTS] Switch events were lost; resynchronized from the latest scan\n");
+	}
+
+	while(scanner->pop_switch_event(event)) {
+		if(!sequence_after(event.sequence, sequence)) {
+			continue;
+		}
+
+		int row = event.switch_id / 12;
+		int col = event.switch_id % 12;
+
+		if(event.level) {
+			switches[row] |= (1u << col);
+		}
+		else {
+			switches[row] &= ~(1u << col);
+		}
+
+		// Later events of the same sample must still apply
+		sequence = event.sequence - 1;
+
+		return true;
+	}
+
+	return false;
 }
 
 // =============================================================
-// Session
+// Main loop wake-up
 // =============================================================
 
-enum class SessionResult {
-	Exit,
-	RestartSession,
-	ReloadConfigRestartSession
-};
+static void signal_event_fd(int event_fd) {
+	uint64_t increment = 1;
 
-static SessionResult run_session(const char *binary_path, const ConfigurationEntry *config_entry) {
-	bool switches[3][12];
+	ssize_t written = write(event_fd, &increment, sizeof(increment));
+	(void) written;
+}
 
-	read_state_switches(switches);
-	decode_state_switches(switches, panel);
+static void drain_event_fd(int event_fd) {
+	uint64_t count;
 
-	uint32_t initial_low12 = panel.switch_state & 0xFFF;
+	ssize_t bytes_read = read(event_fd, &count, sizeof(count));
+	(void) bytes_read;
+}
 
-	logger->info("Initial SR[11:0]: %o\n", initial_low12);
+// Blocks until the simulator, the scanner or a simulator command has something for the panel logic
+// Returns true when the scanner signaled (switch events or encoder steps)
+static bool wait_panel_events(int command_fd) {
+	struct pollfd descriptors[3] = {
+		{register_event_fd, POLLIN, 0},
+		{scanner->get_event_fd(), POLLIN, 0},
+		{command_fd, POLLIN, 0}
+	};
 
-	logger->info("Starting OpenSIMH simulator: %s\n", binary_path);
-	logger->info("Using config file: %s\n", config_entry->configuration_file.c_str());
-	logger->info("Boot device: %s\n", config_entry->boot_device.c_str());
+	if(poll(descriptors, 3, WAIT_POLL_INTERVAL_MS) <= 0) {
+		return false;
+	}
 
-	PANEL* simh_panel = sim_panel_start_simulator(binary_path, config_entry->configuration_file.c_str(), 0);
+	if(descriptors[0].revents & POLLIN) {
+		drain_event_fd(register_event_fd);
+	}
 
-	if(!simh_panel) {
-		logger->error("ERROR: sim_panel_start_simulator() failed\n");
-		logger->error("  %s\n", sim_panel_get_error());
+	// Completed commands are collected at the top of the main loop
+	if(descriptors[2].revents & POLLIN) {
+		drain_event_fd(command_fd);
+	}
 
-		return SessionResult::Exit;
+	if(descriptors[1].revents & POLLIN) {
+		drain_event_fd(descriptors[1].fd);
+		return true;
 	}
 
-	logger->info("Connected successfully\n\n");
+	return false;
+}
 
-	// Set up bit sampling for realistic blinkenlights
-	// Sample every instruction, depth of 100 for smooth blinking
-	sim_panel_set_sampling_parameters(simh_panel, 1, 100);
-
-	// Register tracking with bit sampling for address/data buses
-	sim_panel_add_register(simh_panel, "PC", nullptr, sizeof(reg_pc), &reg_pc);
-	sim_panel_add_register_bits(simh_panel, "PC", nullptr, 22, bits_pc);
-	sim_panel_add_register(simh_panel, "IR", nullptr, sizeof(reg_ir), &reg_ir);
-	sim_panel_add_register(simh_panel, "PSW", nullptr, sizeof(reg_psw), &reg_psw);
-	sim_panel_add_register(simh_panel, "R0", nullptr, sizeof(reg_r[0]), &reg_r[0]);
-	sim_panel_add_register(simh_panel, "R1", nullptr, sizeof(reg_r[1]), &reg_r[1]);
-	sim_panel_add_register(simh_panel, "R2", nullptr, sizeof(reg_r[2]), &reg_r[2]);
-	sim_panel_add_register(simh_panel, "R3", nullptr, sizeof(reg_r[3]), &reg_r[3]);
-	sim_panel_add_register(simh_panel, "R4", nullptr, sizeof(reg_r[4]), &reg_r[4]);
-	sim_panel_add_register(simh_panel, "R5", nullptr, sizeof(reg_r[5]), &reg_r[5]);
-	sim_panel_add_register(simh_panel, "SP", nullptr, sizeof(reg_r[6]), &reg_r[6]);
-	sim_panel_add_register(simh_panel, "MMR0", nullptr, sizeof(reg_mmr0), &reg_mmr0);
-	sim_panel_add_register(simh_panel, "MMR3", nullptr, sizeof(reg_mmr3), &reg_mmr3);
-	sim_panel_add_register(simh_panel, "IDMODE", nullptr, sizeof(reg_id_mode), &reg_id_mode);
-
-	// Set up callback for automatic register updates (10ms interval)
-	sim_panel_set_display_callback_interval(simh_panel, display_callback, nullptr, 10000);
+// =============================================================
+// Display callback for register updates
+// =============================================================
 
-	Edge edge_load, edge_exam, edge_dep, edge_step, edge_cont, edge_enable_halt, edge_start;
-	Edge edge_r1_button, edge_r2_button;
-	Edge edge_test;
-	RotaryEncoder r1_encoder(8), r2_encoder(4);
+static void display_callback(PANEL *panel, unsigned long long simulation_time, void *context) {
+	(void) panel;
+	(void) context;
 
-	logger->info("Starting main loop (Ctrl+C to exit)...\n");
+	update_simulation_time.store(simulation_time, std::memory_order_relaxed);
+	update_time_ns.store(monotonic_time_ns(), std::memory_order_relaxed);
 
-	bool use_console_address = false;
-	uint32_t console_address = 0;
-	uint32_t prev_console_address = 0;
+	// Registers are automatically updated in their buffers
+	if(profiler && sim_panel_get_state(panel) == Run) {
+		profiler->sample(reg_pc, reg_psw, reg_id_mode);
+	}
 
-	bool use_data_latched = false;
-	uint16_t data_latched = 0;
-	uint16_t prev_data_latched = 0;
+	// Just signal that new data is available
+	registers_updated.store(true, std::memory_order_release);
+	signal_event_fd(register_event_fd);
+}
 
-	logger->info("BOOT: Booting %s\n", config_entry->boot_device.c_str());
-	sim_panel_exec_boot(simh_panel, config_entry->boot_device.c_str());
+// =============================================================
+// Bulk loading
+// =============================================================
 
-	// Fake register update in the beginning so we update the state right away
-	registers_updated = true;
+// Waits until no command is in flight, handing each completion to the callback
+static bool wait_commands(SimulatorCommandQueue &commands, const std::function<void(const SimulatorCommand &)> &completed) {
+	SimulatorCommand completion;
 
-	if(!panel.flag_enable_halt) {
-		logger->info("[HALT] Entering halt/step mode in the beginning\n");
-		sim_panel_exec_halt(simh_panel);
+	while(commands.get_in_flight() > 0) {
+		if(!program_running) {
+			return false;
+		}
+
+		struct pollfd descriptor = {commands.get_completion_fd(), POLLIN, 0};
+
+		if(poll(&descriptor, 1, WAIT_POLL_INTERVAL_MS) > 0) {
+			drain_event_fd(descriptor.fd);
+		}
+
+		while(commands.pop_completion(completion)) {
+			completed(completion);
+		}
 	}
 
-	SessionResult result = SessionResult::Exit;
+	return true;
+}
 
-	while(program_running) {
-		// Scan switches every iteration for responsive rotary encoders
-		bool switches[3][12];
+// Deposits the image into the halted simulator word by word, optionally reading it back
+// The whole batch is queued at once, but the worker still makes one blocking round trip per word
+// Words with a single byte in the image are examined first, to keep the other byte
+static bool load_memory_image(SimulatorCommandQueue &commands, const MemoryImage &image, bool verify) {
+	const map<uint32_t, ImageWord> &words = image.get_words();
 
-		read_state_switches(switches);
-		decode_state_switches(switches, panel);
-		decode_state_rotary_switches(switches, panel, r1_encoder, r2_encoder);
+	map<uint32_t, uint16_t> values;
+	uint64_t failures = 0;
 
-		// Detect rotary button presses
+	for(auto &word: words) {
+		values[word.first] = word.second.value;
+
+		if(word.second.byte_mask != 3) {
+			SimulatorCommand examine = {};
+			examine.type = SimulatorCommandType::Examine;
+			examine.address = word.first;
+
+			commands.submit(std::move(examine));
+		}
+	}
+
+	bool completed = wait_commands(commands, [&](const SimulatorCommand &command) {
+		if(command.status != 0) {
+			failures++;
+			return;
+		}
+
+		uint16_t image_mask = (words.at(command.address).byte_mask & 1) ? 0x00FF : 0xFF00;
+		values[command.address] = (command.value & ~image_mask) | (values[command.address] & image_mask);
+	});
+
+	if(!completed || failures > 0) {
+		logger->error("[LOAD] Failed to examine %llu partial words\n", (unsigned long long) failures);
+		return false;
+	}
+
+	uint64_t start_ns = monotonic_time_ns();
+
+	for(auto &value: values) {
+		SimulatorCommand deposit = {};
+		deposit.type = SimulatorCommandType::Deposit;
+		deposit.address = value.first;
+		deposit.value = value.second;
+
+		commands.submit(std::move(deposit));
+	}
+
+	completed = wait_commands(commands, [&](const SimulatorCommand &command) {
+		failures += (command.status != 0);
+	});
+
+	double elapsed_s = (monotonic_time_ns() - start_ns) / (double) NS_PER_SECOND;
+
+	logger->info("[LOAD] Deposited %zu words (%llu bytes) in %.3f s: %.0f words/s, %.1f us per word, %llu failed\n",
+		values.size(), (unsigned long long) image.get_byte_count(), elapsed_s,
+		values.size() / elapsed_s, 1e6 * elapsed_s / values.size(), (unsigned long long) failures);
+
+	if(!completed || failures > 0) {
+		return false;
+	}
+
+	if(!verify) {
+		return true;
+	}
+
+	uint64_t mismatches = 0;
+
+	start_ns = monotonic_time_ns();
+
+	for(auto &value: values) {
+		SimulatorCommand examine = {};
+		examine.type = SimulatorCommandType::Examine;
+		examine.address = value.first;
+
+		commands.submit(std::move(examine));
+	}
+
+	completed = wait_commands(commands, [&](const SimulatorCommand &command) {
+		if(command.status != 0 || command.value != values[command.address]) {
+			if(mismatches < 8) {
+				logger->error("[LOAD] Verify %06o: expected %06o, read %06o%s\n", command.address,
+					values[command.address], command.value, (command.status != 0) ? " (examine failed)" : "");
+			}
+
+			mismatches++;
+		}
+	});
+
+	elapsed_s = (monotonic_time_ns() - start_ns) / (double) NS_PER_SECOND;
+
+	logger->info("[LOAD] Verified %zu words in %.3f s: %.0f words/s, %llu mismatches\n",
+		values.size(), elapsed_s, values.size() / elapsed_s, (unsigned long long) mismatches);
+
+	return completed && mismatches == 0;
+}
+
+// =============================================================
+// Session
+// =============================================================
+
+// Takes the simulator kept for the configuration, if any, and makes room for the one of the session
+static bool take_kept_simulator(const char *binary_path, const ConfigurationEntry *config_entry, KeptSimulator &kept) {
+	bool found = false;
+
+	for(auto iterator = kept_simulators.begin(); iterator != kept_simulators.end(); ++iterator) {
+		if(iterator->binary_path == binary_path && iterator->directory == config_entry->directory &&
+			iterator->configuration_file == config_entry->configuration_file) {
+			kept = *iterator;
+			kept_simulators.erase(iterator);
+
+			found = true;
+			break;
+		}
+	}
+
+	while(!kept_simulators.empty() && kept_simulators.size() >= simulator_instances) {
+		auto oldest = std::min_element(kept_simulators.begin(), kept_simulators.end(), [](const KeptSimulator &a, const KeptSimulator &b) {
+			return a.detached_ns < b.detached_ns;
+		});
+
+		logger->info("[SESSION] Stopping the simulator of entry %06o\n", oldest->switch_code);
+
+		sim_panel_destroy(oldest->panel);
+		kept_simulators.erase(oldest);
+	}
+
+	return found;
+}
+
+static void destroy_kept_simulators() {
+	for(KeptSimulator &kept : kept_simulators) {
+		sim_panel_destroy(kept.panel);
+	}
+
+	kept_simulators.clear();
+}
+
+static void report_simulator_instances(uint32_t switch_code, SimulatorProcess &process, bool reset) {
+	char name[64];
+
+	snprintf(name, sizeof(name), "Entry %06o, attached", switch_code);
+	process.report_statistics(name, reset);
+
+	for(KeptSimulator &kept : kept_simulators) {
+		snprintf(name, sizeof(name), "Entry %06o, %s", kept.switch_code, kept.background ? "background" : "halted");
+		kept.process.report_statistics(name, reset);
+	}
+}
+
+enum class SessionResult {
+	Exit,
+	RestartSession,
+	ReloadConfigRestartSession
+};
+
+// <allow_resume>: resume a background simulator or a snapshot instead of booting
+static SessionResult run_session(const char *binary_path, const ConfigurationEntry *config_entry, bool allow_resume) {
+	uint16_t switches[3];
+
+	scanner->wait_switches(switches, WAIT_FIRST_SCAN_MS);
+	decode_state_switches(switches, panel);
+
+	uint32_t initial_low12 = panel.switch_state & 0xFFF;
+
+	logger->info("Initial SR[11:0]: %o\n", initial_low12);
+
+	register_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if(register_event_fd < 0) {
+		logger->error("ERROR: eventfd() failed: %s\n", strerror(errno));
+
+		return SessionResult::Exit;
+	}
+
+	KeptSimulator kept = {};
+
+	bool reused_simulator = take_kept_simulator(binary_path, config_entry, kept);
+
+	PANEL* simh_panel = reused_simulator ? kept.panel : nullptr;
+	SimulatorProcess process = kept.process;
+
+	// A background simulator is attached as it is, without booting
+	bool attached_background = reused_simulator && kept.background && allow_resume && !memory_image;
+
+	// Run time of the guest before this session, when resumed from a snapshot
+	bool restored_snapshot = false;
+	double restored_guest_time_s = attached_background ? kept.restored_guest_time_s : 0;
+
+	if(attached_background) {
+		logger->info("[SESSION] Attaching to the background simulator of entry %06o\n\n", config_entry->switch_code);
+	}
+	else if(reused_simulator) {
+		logger->info("[SESSION] Reusing the simulator of the previous session\n");
+		logger->info("Boot device: %s\n\n", config_entry->boot_device.c_str());
+	}
+	else {
+		string configuration_file = config_entry->configuration_file;
+
+		if(snapshots && allow_resume && !memory_image) {
+			restored_snapshot = snapshots->prepare_restore(binary_path, *config_entry, configuration_file, restored_guest_time_s);
+		}
+
+		logger->info("Starting OpenSIMH simulator: %s\n", binary_path);
+		logger->info("Using config file: %s\n", configuration_file.c_str());
+
+		if(restored_snapshot) {
+			logger->info("[SNAPSHOT] Resuming the guest after %.1f s of run time instead of booting\n", restored_guest_time_s);
+		}
+		else {
+			logger->info("Boot device: %s\n", config_entry->boot_device.c_str());
+		}
+
+		vector<pid_t> children = SimulatorProcess::list_children();
+
+		simh_panel = sim_panel_start_simulator(binary_path, configuration_file.c_str(), 0);
+
+		if(!simh_panel) {
+			logger->error("ERROR: sim_panel_start_simulator() failed\n");
+			logger->error("  %s\n", sim_panel_get_error());
+
+			close(register_event_fd);
+			register_event_fd = -1;
+
+			return SessionResult::Exit;
+		}
+
+		logger->info("Connected successfully\n\n");
+
+		if(!process.find(children)) {
+			logger->error("[INSTANCES] Simulator process not found, no CPU accounting or affinity\n");
+		}
+		else if(use_simulator_cpus) {
+			process.set_affinity(simulator_cpus);
+		}
+	}
+
+	uint64_t connected_ns = monotonic_time_ns();
+	uint64_t first_instruction_ns = attached_background ? kept.first_instruction_ns : 0;
+
+	// Set up bit sampling for realistic blinkenlights
+	// Sample every instruction, deep enough for smooth brightness levels (retuned with the update interval)
+	sim_panel_set_sampling_parameters(simh_panel, 1, BLINKENLIGHT_SAMPLE_DEPTH);
+
+	// Registers the simulator can ship with every update (see RegisterBit for the order)
+	RegisterSubscriptions subscriptions;
+
+	subscriptions.define("PC", sizeof(reg_pc), &reg_pc);
+	subscriptions.define("PSW", sizeof(reg_psw), &reg_psw);
+	subscriptions.define("MMR0", sizeof(reg_mmr0), &reg_mmr0);
+	subscriptions.define("MMR3", sizeof(reg_mmr3), &reg_mmr3);
+	subscriptions.define("IDMODE", sizeof(reg_id_mode), &reg_id_mode);
+	subscriptions.define("IR", sizeof(reg_ir), &reg_ir);
+	subscriptions.define("R0", sizeof(reg_r[0]), &reg_r[0]);
+	subscriptions.define("R1", sizeof(reg_r[1]), &reg_r[1]);
+	subscriptions.define("R2", sizeof(reg_r[2]), &reg_r[2]);
+	subscriptions.define("R3", sizeof(reg_r[3]), &reg_r[3]);
+	subscriptions.define("R4", sizeof(reg_r[4]), &reg_r[4]);
+	subscriptions.define("R5", sizeof(reg_r[5]), &reg_r[5]);
+	subscriptions.define("SP", sizeof(reg_r[6]), &reg_r[6]);
+
+	subscriptions.subscribed(kept.registers);
+
+	// Only what the panel shows in its initial position, the rest is added on demand
+	// (a background simulator may still be running and refuse them until it halts)
+	uint32_t initial_registers = required_registers(panel, false) | required_registers(panel, true);
+
+	bool initially_halted = !attached_background || sim_panel_get_state(simh_panel) != Run;
+
+	for(auto &missing: subscriptions.take_missing(initial_registers, initially_halted)) {
+		bool success = (sim_panel_add_register(simh_panel, missing.name.c_str(), nullptr, missing.size, missing.storage) == 0);
+
+		subscriptions.added(missing.name, success);
+	}
+
+	// Bit sampling of the PC for the address lamps
+	if(!reused_simulator) {
+		sim_panel_add_register_bits(simh_panel, "PC", nullptr, 22, bits_pc);
+	}
+
+	// Set up callback for automatic register updates
+	sim_panel_set_display_callback_interval(simh_panel, display_callback, nullptr, REGISTER_UPDATE_INTERVAL_US);
+
+	// From here on, commands run on the worker thread of the queue
+	SimulatorCommandQueue commands;
+
+	commands.set_display_callback(display_callback, nullptr);
+
+	if(!commands.init(simh_panel)) {
+		logger->error("ERROR: Failed to start the simulator command queue\n");
+
+		sim_panel_destroy(simh_panel);
+
+		close(register_event_fd);
+		register_event_fd = -1;
+
+		return SessionResult::Exit;
+	}
+
+	Edge edge_load, edge_exam, edge_dep, edge_step, edge_cont, edge_enable_halt, edge_start;
+	Edge edge_r1_button, edge_r2_button;
+	Edge edge_test;
+	RotaryEncoder r1_encoder(8), r2_encoder(4);
+
+	logger->info("Starting main loop (Ctrl+C to exit)...\n");
+
+	bool use_console_address = false;
+	uint32_t console_address = 0;
+	uint32_t prev_console_address = 0;
+
+	bool use_data_latched = false;
+	uint16_t data_latched = 0;
+	uint16_t prev_data_latched = 0;
+
+	auto latch_data = [&](const char *action, uint16_t value) {
+		prev_data_latched = data_latched;
+		data_latched = value;
+		logger->debug("[%s] data_latched: %06o -> %06o\n", action, prev_data_latched, data_latched);
+
+		if(!use_data_latched) {
+			logger->debug("[%s] data latch ON\n", action);
+			use_data_latched = true;
+		}
+	};
+
+	// EXAMs are served from the cache; on a miss, the data latch waits for the examine of that address
+	ExamineCache examine_cache;
+
+	bool exam_waiting = false;
+	uint32_t exam_wait_address = 0;
+	uint64_t exam_wait_tag = 0;
+
+	auto fetch_examine = [&](uint32_t address) {
+		SimulatorCommand examine = {};
+		examine.type = SimulatorCommandType::Examine;
+		examine.address = address;
+
+		examine_cache.fetching(address, commands.submit(std::move(examine)));
+	};
+
+	// While commands that start or stop the simulator are in flight, the panel acts on the state they lead to
+	unsigned state_commands = 0;
+	bool expected_running = false;
+
+	auto is_simulator_running = [&]() {
+		return state_commands ? expected_running : (sim_panel_get_state(simh_panel) == Run);
+	};
+
+	// Snapshot on demand: the HALT it waits for, and whether the guest continues after the SAVE
+	uint64_t snapshot_halt_id = 0;
+	bool snapshot_resume = false;
+
+	auto get_guest_time_s = [&]() {
+		return restored_guest_time_s + (monotonic_time_ns() - first_instruction_ns) / (double) NS_PER_SECOND;
+	};
+
+	// START: PC <- address; RUN if enabled (queued right behind the PC change)
+	auto submit_start = [&](uint32_t address, uint64_t tag) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%u", address);
+
+		SimulatorCommand set_pc = {};
+		set_pc.type = SimulatorCommandType::SetRegister;
+		set_pc.name = "PC";
+		set_pc.text = buffer;
+		set_pc.address = address;
+
+		if(panel.flag_enable_halt) {
+			logger->debug("[START] running from new PC\n");
+
+			commands.submit(std::move(set_pc));
+			commands.submit(SimulatorCommandType::Run, tag);
+			state_commands++;
+			expected_running = true;
+		}
+		else {
+			set_pc.tag = tag;
+			commands.submit(std::move(set_pc));
+		}
+
+		examine_cache.invalidate();
+	};
+
+	if(attached_background) {
+		// Left as it is, the ENABLE/HALT switch acts on its next change
+		logger->info("[SESSION] Switched to entry %06o (%s) in %.1f ms\n", config_entry->switch_code,
+			sim_panel_get_state(simh_panel) == Run ? "running" : "halted", (monotonic_time_ns() - session_request_ns) / 1e6);
+	}
+	else if(memory_image) {
+		// The simulator stays halted after reading its configuration
+		logger->info("[LOAD] Loading %s instead of booting\n", memory_image->get_path().c_str());
+
+		uint32_t start_address;
+
+		if(!load_memory_image(commands, *memory_image, verify_memory_image)) {
+			// Memory may hold part of the image: starting it could run anything
+			logger->error("[LOAD] Loading %s failed, the program is not started and the simulator stays halted\n",
+				memory_image->get_path().c_str());
+		}
+		else if(!memory_image->get_start_address(start_address)) {
+			logger->info("[LOAD] %s has no start address, the simulator stays halted\n", memory_image->get_path().c_str());
+		}
+		else {
+			logger->info("[START] Setting PC to start address %06o\n", start_address);
+
+			console_address = start_address;
+			use_console_address = true;
+
+			submit_start(start_address, 0);
+		}
+	}
+	else if(restored_snapshot) {
+		// The restored simulator is halted where the snapshot was taken
+		if(panel.flag_enable_halt) {
+			logger->info("[SNAPSHOT] Continuing the restored guest\n");
+
+			commands.submit(SimulatorCommandType::Run);
+			state_commands++;
+			expected_running = true;
+		}
+		else {
+			logger->info("[HALT] Staying halted at the restored state\n");
+		}
+	}
+	else {
+		logger->info("BOOT: Booting %s\n", config_entry->boot_device.c_str());
+
+		SimulatorCommand boot = {};
+		boot.type = SimulatorCommandType::Boot;
+		boot.name = config_entry->boot_device;
+
+		commands.submit(std::move(boot));
+		state_commands++;
+		expected_running = true;
+
+		if(!panel.flag_enable_halt) {
+			logger->info("[HALT] Entering halt/step mode in the beginning\n");
+
+			commands.submit(SimulatorCommandType::Halt);
+			state_commands++;
+			expected_running = false;
+		}
+	}
+
+	// Fake register update in the beginning so we update the state right away
+	registers_updated.store(true);
+
+	SessionResult result = SessionResult::Exit;
+
+	// Use blinkkenlights only when the PC is displayed in the panel
+	bool use_blinkenlights = false;
+
+	// The switch state is only changed by events from here on
+	uint32_t switch_sequence = scanner->get_switches(switches);
+	uint64_t dropped_switch_events = scanner->get_dropped_switch_events();
+
+	bool scanner_signaled = false;
+
+	CpuUsage cpu_usage;
+
+	ActionLatency action_latency;
+
+	// Register updates follow the LED frame rate, and slow down once the simulator has been halted and idle for a while
+	DisplayRateController display_rate(display_rate_configuration, BLINKENLIGHT_SAMPLE_DEPTH, {REGISTER_UPDATE_INTERVAL_US, 1});
+	uint64_t register_activity_ns = monotonic_time_ns();
+
+	// What the scanner thread is currently displaying
+	PanelState published_panel = {};
+	bool published_blinkenlights = false;
+	bool published_any = false;
+
+	while(program_running) {
+		// Switch changes are applied one event per iteration, in the order the scanner saw them,
+		// so fast sequences are never collapsed; encoder steps come with a scanner signal only
+		SwitchEvent event;
+		bool have_event = next_switch_event(switches, switch_sequence, dropped_switch_events, event);
+		bool samples_updated = registers_updated.exchange(false, std::memory_order_acquire);
+
+		// Apply the results of simulator commands that completed since the last iteration
+		SimulatorCommand completion;
+		bool command_completed = false;
+		bool panel_command_completed = false;
+
+		while(commands.pop_completion(completion)) {
+			command_completed = true;
+			panel_command_completed |= (completion.type != SimulatorCommandType::SetCallbackInterval &&
+				completion.type != SimulatorCommandType::SetSamplingParameters);
+
+			switch(completion.type) {
+				case SimulatorCommandType::Boot:
+				case SimulatorCommandType::Run:
+					state_commands--;
+
+					if(completion.status == 0 && first_instruction_ns == 0) {
+						first_instruction_ns = completion.complete_time_ns;
+
+						logger->info("[SESSION] Restart to first instruction: %.1f ms (simulator %s after %.1f ms, running %.1f ms later)\n",
+							(first_instruction_ns - session_request_ns) / 1e6,
+							reused_simulator ? "reused" : (restored_snapshot ? "restored" : "started"),
+							(connected_ns - session_request_ns) / 1e6, (first_instruction_ns - connected_ns) / 1e6);
+
+						if(snapshots) {
+							snapshots->record_session(restored_snapshot, first_instruction_ns - session_request_ns, restored_guest_time_s);
+						}
+					}
+
+					break;
+
+				case SimulatorCommandType::Halt:
+					state_commands--;
+
+					// The console address follows the PC, unless LOAD ADDR changed it meanwhile
+					if(completion.status == 0 && use_console_address && console_address == completion.address) {
+						console_address = reg_pc & 0x3FFFFF;
+					}
+
+					if(completion.id == snapshot_halt_id) {
+						snapshot_halt_id = 0;
+
+						if(completion.status == 0) {
+							snapshots->save(binary_path, *config_entry, get_guest_time_s());
+						}
+
+						// Unless the panel halted or started it meanwhile
+						if(snapshot_resume && state_commands == 0 && panel.flag_enable_halt) {
+							commands.submit(SimulatorCommandType::Run);
+							state_commands++;
+							expected_running = true;
+						}
+					}
+
+					break;
+
+				case SimulatorCommandType::Step:
+					break;
+
+				case SimulatorCommandType::Examine:
+					if(!examine_cache.fill(completion.address, completion.id, completion.status == 0, completion.value)) {
+						break;
+					}
+
+					if(exam_waiting && completion.address == exam_wait_address) {
+						exam_waiting = false;
+
+						if(completion.status == 0) {
+							latch_data("EXAM", completion.value);
+
+							if(exam_wait_tag) {
+								action_latency.record(completion.complete_time_ns - exam_wait_tag);
+							}
+						}
+						else if(console_address == increment_console_address(completion.address)) {
+							// The address was advanced on the EXAM, stay on the failed one
+							console_address = completion.address;
+						}
+					}
+
+					break;
+
+				case SimulatorCommandType::Deposit:
+					if(completion.status == 0) {
+						latch_data("DEP", completion.value);
+					}
+					else if(console_address == increment_console_address(completion.address)) {
+						// The address was advanced on submission, stay on the failed one
+						console_address = completion.address;
+					}
+
+					break;
+
+				case SimulatorCommandType::SetRegister:
+					if(completion.status == 0) {
+						reg_pc = completion.address;
+					}
+
+					break;
+
+				case SimulatorCommandType::AddRegister:
+					subscriptions.added(completion.name, completion.status == 0);
+					break;
+
+				case SimulatorCommandType::SetCallbackInterval:
+				case SimulatorCommandType::SetSamplingParameters:
+					break;
+			}
+
+			// Switch to completed simulator action
+			if(completion.tag) {
+				action_latency.record(completion.complete_time_ns - completion.tag);
+			}
+		}
+
+		// Sleep until the simulator, the scanner or a command has something new
+		if(!have_event && !samples_updated && !command_completed && !scanner_signaled) {
+			scanner_signaled = wait_panel_events(commands.get_completion_fd());
+			continue;
+		}
+
+		scanner_signaled = false;
+
+		uint64_t iteration_start_ns = monotonic_time_ns();
+
+		decode_state_switches(switches, panel);
+		decode_state_rotary_switches(switches, panel, r1_encoder, r2_encoder);
+
+		// Detect rotary button presses
 		if(edge_r1_button.rising(panel.r1_button)) {
 			logger->info("[R1 BUTTON] Reload configuration requested\n");
 			result = SessionResult::ReloadConfigRestartSession;
@@ -747,6 +1580,26 @@ static SessionResult run_session(const char *binary_path, const ConfigurationEnt
 			break;
 		}
 
+		// SIGUSR1: the guest is halted for the SAVE (once it ran in this session)
+		if(snapshot_requested) {
+			snapshot_requested = 0;
+
+			if(!snapshots || first_instruction_ns == 0 || snapshot_halt_id) {
+				logger->info("[SNAPSHOT] Nothing to save now\n");
+			}
+			else {
+				snapshot_resume = is_simulator_running();
+
+				SimulatorCommand halt = {};
+				halt.type = SimulatorCommandType::Halt;
+				halt.address = ~0u;
+
+				snapshot_halt_id = commands.submit(std::move(halt));
+				state_commands++;
+				expected_running = false;
+			}
+		}
+
 		// TEST switch: print debug state
 		if(edge_test.rising(panel.flag_test)) {
 			logger->info("\n========== DEBUG STATE DUMP (TEST) ==========\n");
@@ -788,144 +1641,268 @@ static SessionResult run_session(const char *binary_path, const ConfigurationEnt
 			for(int row = 0; row < 3; row++) {
 				logger->info("  Row %d: ", row);
 
-				for(int col = 0; col < 12; col++) {
-					logger->info("%d ", switches[row][col] ? 1 : 0);
+				for(int col = 0; col < 12; col++) {
+					logger->info("%d ", (switches[row] >> col) & 1);
+				}
+
+				logger->info("\n");
+			}
+
+			// LED refresh timing
+			logger->info("\n");
+			scanner->report_statistics(false);
+			precision_timer->report_statistics(false);
+			commands.report_statistics(false);
+			examine_cache.report_statistics(false);
+			subscriptions.report_statistics(false);
+			display_rate.report_statistics(false);
+
+			if(snapshots) {
+				snapshots->report_statistics(false);
+			}
+
+			report_simulator_instances(config_entry->switch_code, process, false);
+			action_latency.report(false);
+			cpu_usage.report(false);
+
+			logger->info("=============================================\n\n");
+		}
+
+		// Control switches act on every switch event, independently of the register refresh
+		// Simulator commands are only submitted here, their results are applied when they complete
+		bool simulator_running = is_simulator_running();
+
+		bool control_action = false;
+
+		// Latency of actions with a simulator command is recorded on completion
+		uint64_t action_tag = have_event ? event.timestamp_ns : 0;
+		bool action_submitted = false;
+
+		// LOAD ADDR: console_address <- switch_register
+		if(!simulator_running && edge_load.falling(panel.flag_load_addr)) {
+			control_action = true;
+
+			prev_console_address = console_address;
+			console_address = panel.switch_state & 0x3FFFFF;
+			logger->debug("[LOAD] console_address: %06o -> %06o\n", prev_console_address, console_address);
+			use_console_address = true;
+
+			if(use_data_latched) {
+				logger->debug("[LOAD] data latch OFF\n");
+				use_data_latched = false;
+			}
+		}
+
+		// EXAM: data <- memory[console_address]; console_address++
+		if(!simulator_running && edge_exam.falling(panel.flag_exam)) {
+			control_action = true;
+
+			uint16_t value;
+
+			if(examine_cache.lookup(console_address, value)) {
+				exam_waiting = false;
+				latch_data("EXAM", value);
+			}
+			else {
+				exam_waiting = true;
+				exam_wait_address = console_address;
+				exam_wait_tag = action_tag;
+
+				if(!examine_cache.contains(console_address)) {
+					fetch_examine(console_address);
+				}
+
+				action_submitted = true;
+			}
+
+			// Keep the following words examined ahead, queued as one batch (one round trip per word)
+			uint32_t address = console_address;
+
+			for(unsigned int i = 1; i < examine_block_words; i++) {
+				address = increment_console_address(address);
+
+				if(address >= IO_PAGE_START) {
+					break;
 				}
 
-				logger->info("\n");
+				if(!examine_cache.contains(address)) {
+					fetch_examine(address);
+				}
 			}
 
-			logger->info("=============================================\n\n");
+			// Advanced right away, so that EXAMs in quick succession queue behind each other
+			prev_console_address = console_address;
+			console_address = increment_console_address(console_address);
+			logger->debug("[EXAM] console_address: %06o -> %06o\n", prev_console_address, console_address);
 		}
 
-		// Use blinkkenlights only when the PC is displayed in the panel
-		bool use_blinkenlights = false;
+		// DEP: memory[console_address] <- switch_register; console_address++
+		// Note that the switch action of DEP is inverted, but the signal is still 1 on the default state
+		if(!simulator_running && edge_dep.falling(panel.flag_dep)) {
+			control_action = true;
 
-		// Process updates when callback signals new register data
-		if(registers_updated) {
-			registers_updated = false;
+			SimulatorCommand deposit = {};
+			deposit.type = SimulatorCommandType::Deposit;
+			deposit.address = console_address;
+			deposit.value = (uint16_t)(panel.switch_state & 0xFFFF);
+			deposit.tag = action_tag;
 
-			OperationalState state = sim_panel_get_state(simh_panel);
-			bool simulator_running = (state == Run);
+			commands.submit(std::move(deposit));
+			examine_cache.invalidate();
+			action_submitted = true;
 
-			// LOAD ADDR: console_address <- switch_register
-			if(!simulator_running && edge_load.falling(panel.flag_load_addr)) {
-				prev_console_address = console_address;
-				console_address = panel.switch_state & 0x3FFFFF;
-				logger->debug("[LOAD] console_address: %06o -> %06o\n", prev_console_address, console_address);
-				use_console_address = true;
+			prev_console_address = console_address;
+			console_address = increment_console_address(console_address);
+			logger->debug("[DEP] console_address: %06o -> %06o\n", prev_console_address, console_address);
+		}
 
-				if(use_data_latched) {
-					logger->debug("[LOAD] data latch OFF\n");
-					use_data_latched = false;
-				}
+		// CONT: execute based on S_INST/S_BC switch state
+		if(edge_cont.falling(panel.flag_cont)) {
+			control_action = true;
+
+			if(panel.flag_sinst_sbus_cycle) {
+				// S_INST/S_BC active: single step
+				logger->debug("[CONT (single step)]\n");
+			}
+			else {
+				// S_INST/S_BC inactive: single step but give different message
+				logger->debug("[CONT (single step)] - ignoring S_BC\n");
 			}
 
-			// EXAM: data <- memory[console_address]; console_address++
-			if(!simulator_running && edge_exam.falling(panel.flag_exam)) {
-				uint16_t value = 0;
+			commands.submit(SimulatorCommandType::Step, action_tag);
+			examine_cache.invalidate();
+			action_submitted = true;
+		}
 
-				if(sim_panel_mem_examine(simh_panel, sizeof(console_address), &console_address, sizeof(value), &value) == 0) {
-					prev_data_latched = data_latched;
-					data_latched = value;
-					logger->debug("[EXAM] data_latched: %06o -> %06o\n", prev_data_latched, data_latched);
+		// ENABLE/HALT: edge-triggered control
+		if(simulator_running) {
+			if(edge_enable_halt.falling(panel.flag_enable_halt)) {
+				control_action = true;
 
-					if(!use_data_latched) {
-						logger->debug("[EXAM] data latch ON\n");
-						use_data_latched = true;
-					}
+				// Transitioned to halt mode
+				logger->info("[HALT] Entering halt (step) mode\n");
 
-					prev_console_address = console_address;
-					console_address = increment_console_address(console_address);
-					logger->debug("[EXAM] console_address: %06o -> %06o\n", prev_console_address, console_address);
+				if(!use_console_address) {
+					logger->debug("[HALT] console address ON\n");
+					use_console_address = true;
 				}
+				console_address = reg_pc & 0x3FFFFF;
+
+				// Updated again with the PC where the simulator actually stopped
+				SimulatorCommand halt = {};
+				halt.type = SimulatorCommandType::Halt;
+				halt.address = console_address;
+				halt.tag = action_tag;
+
+				commands.submit(std::move(halt));
+				state_commands++;
+				expected_running = false;
+				action_submitted = true;
 			}
+		}
+		else {
+			if(edge_enable_halt.rising(panel.flag_enable_halt)) {
+				control_action = true;
 
-			// DEP: memory[console_address] <- switch_register; console_address++
-			// Note that the switch action of DEP is inverted, but the signal is still 1 on the default state
-			if(!simulator_running && edge_dep.falling(panel.flag_dep)) {
-				uint16_t value = (uint16_t)(panel.switch_state & 0xFFFF);
+				// Transitioned to run mode
+				logger->info("[ENABLE] Entering enable mode\n");
 
-				if(sim_panel_mem_deposit(simh_panel, sizeof(console_address), &console_address, sizeof(value), &value) == 0) {
-					prev_data_latched = data_latched;
-					data_latched = value;
-					logger->debug("[DEP] data_latched: %06o -> %06o\n", prev_data_latched, data_latched);
+				commands.submit(SimulatorCommandType::Run, action_tag);
+				examine_cache.invalidate();
+				state_commands++;
+				expected_running = true;
+				action_submitted = true;
 
-					if(!use_data_latched) {
-						logger->debug("[DEP] data latch ON\n");
-						use_data_latched = true;
-					}
+				if(use_console_address) {
+					logger->debug("[ENABLE] console address OFF\n");
+					use_console_address = false;
+				}
 
-					prev_console_address = console_address;
-					console_address = increment_console_address(console_address);
-					logger->debug("[DEP] console_address: %06o -> %06o\n", prev_console_address, console_address);
+				if(use_data_latched) {
+					logger->debug("[ENABLE] data latch OFF\n");
+					use_data_latched = false;
 				}
 			}
+		}
 
-			// CONT: execute based on S_INST/S_BC switch state
-			if(edge_cont.falling(panel.flag_cont)) {
-				if(panel.flag_sinst_sbus_cycle) {
-					// S_INST/S_BC active: single step
-					logger->debug("[CONT (single step)]\n");
-				}
-				else {
-					// S_INST/S_BC inactive: single step but give different message
-					logger->debug("[CONT (single step)] - ignoring S_BC\n");
-				}
+		// START: PC <- console_address; RUN
+		if(edge_start.falling(panel.flag_start)) {
+			control_action = true;
 
-				sim_panel_exec_step(simh_panel);
-			}
+			logger->info("[START] Setting PC to console_address %06o\n", console_address);
 
-			// ENABLE/HALT: edge-triggered control
-			if(simulator_running) {
-				if(edge_enable_halt.falling(panel.flag_enable_halt)) {
-					// Transitioned to halt mode
-					logger->info("[HALT] Entering halt (step) mode\n");
-					sim_panel_exec_halt(simh_panel);
+			submit_start(console_address, action_tag);
+			action_submitted = true;
+		}
 
-					if(!use_console_address) {
-						logger->debug("[HALT] console address ON\n");
-						use_console_address = true;
-					}
-					console_address = reg_pc & 0x3FFFFF;
-				}
+		if(control_action) {
+			if(have_event && !action_submitted) {
+				action_latency.record(monotonic_time_ns() - event.timestamp_ns);
 			}
-			else {
-				if(edge_enable_halt.rising(panel.flag_enable_halt)) {
-					// Transitioned to run mode
-					logger->info("[ENABLE] Entering enable mode\n");
-					sim_panel_exec_run(simh_panel);
-
-					if(use_console_address) {
-						logger->debug("[ENABLE] console address OFF\n");
-						use_console_address = false;
-					}
 
-					if(use_data_latched) {
-						logger->debug("[ENABLE] data latch OFF\n");
-						use_data_latched = false;
-					}
-				}
-			}
+			simulator_running = is_simulator_running();
+		}
 
-			// START: PC <- console_address; RUN
-			if(edge_start.falling(panel.flag_start)) {
-				char buffer[32];
-				snprintf(buffer, sizeof(buffer), "%u", console_address);
+		// Memory can change under a running simulator, whatever started it
+		if(simulator_running) {
+			examine_cache.invalidate();
+		}
 
-				logger->info("[START] Setting PC to console_address %06o\n", console_address);
+		// Subscribe to the registers the lamps need in the current mode
+		for(auto &missing: subscriptions.take_missing(required_registers(panel, simulator_running), !simulator_running)) {
+			logger->debug("[REGISTERS] Subscribing to %s\n", missing.name.c_str());
 
-				if(sim_panel_set_register_value(simh_panel, "PC", buffer) == 0) {
-					reg_pc = console_address;
-				}
+			SimulatorCommand add = {};
+			add.type = SimulatorCommandType::AddRegister;
+			add.name = missing.name;
+			add.storage = missing.storage;
+			add.size = missing.size;
 
-				// Run only if it is enabled
-				if(panel.flag_enable_halt) {
-					logger->debug("[START] running from new PC\n");
-					sim_panel_exec_run(simh_panel);
-				}
+			commands.submit(std::move(add));
+		}
+
+		uint64_t now_ns = monotonic_time_ns();
+
+		if(simulator_running || control_action || panel_command_completed) {
+			register_activity_ns = now_ns;
+		}
+
+		bool halted_idle = (now_ns - register_activity_ns > REGISTER_UPDATE_HOLD_NS);
+
+		// Published before registers_updated
+		if(samples_updated && simulator_running) {
+			display_rate.record_simulation_time(update_simulation_time.load(std::memory_order_relaxed), update_time_ns.load(std::memory_order_relaxed));
+		}
+
+		DisplayRate previous_rate = display_rate.get_rate();
+		DisplayRate rate;
+
+		if(display_rate.update(scanner->get_frame_period_ns(), simulator_running, halted_idle, now_ns, rate)) {
+			logger->debug("[DISPLAY] Register updates every %u us, PC sampled every %u instructions\n", rate.interval_us, rate.sample_frequency);
+
+			if(rate.interval_us != previous_rate.interval_us) {
+				SimulatorCommand interval = {};
+				interval.type = SimulatorCommandType::SetCallbackInterval;
+				interval.interval_us = rate.interval_us;
+
+				commands.submit(std::move(interval));
 			}
 
+			if(rate.sample_frequency != previous_rate.sample_frequency) {
+				SimulatorCommand sampling = {};
+				sampling.type = SimulatorCommandType::SetSamplingParameters;
+				sampling.sample_frequency = rate.sample_frequency;
+				sampling.sample_depth = BLINKENLIGHT_SAMPLE_DEPTH;
+
+				commands.submit(std::move(sampling));
+			}
+		}
+
+		cpu_usage.update(simulator_running);
+
+		// Refresh the lamps when the callback signals new register data, a control switch acted
+		// or a simulator command completed
+		if(samples_updated || control_action || command_completed) {
 			// Update status lamps from simulator state
 			compute_ksu_from_psw(panel);
 
@@ -1016,58 +1993,426 @@ static SessionResult run_session(const char *binary_path, const ConfigurationEnt
 				panel.flag_par_high = false;
 			}
 		}
-		else {
-			struct timespec time_specification = {0, WAIT_LOOP_INTERVAL_NS};
 
-			nanosleep(&time_specification, nullptr);
-		}
+		// Hand a new LED frame to the scanner thread only when the lights change
+		// (blinkenlights change with every new set of samples)
+		if(!published_any || !same_state_lights(panel, published_panel) ||
+			use_blinkenlights != published_blinkenlights || (use_blinkenlights && samples_updated)) {
+			LEDFrame frame;
+
+			encode_state_lights(panel, frame, use_blinkenlights ? bits_pc : nullptr);
+			scanner->publish_frame(frame);
 
-		// Update and drive LED display
-		bool leds[6][12];
+			published_panel = panel;
+			published_blinkenlights = use_blinkenlights;
+			published_any = true;
+		}
 
-		encode_state_lights(panel, leds, use_blinkenlights ? bits_pc : nullptr);
-		write_state_lights(leds);
+		if(samples_updated) {
+			display_rate.record_update_cost(monotonic_time_ns() - iteration_start_ns);
+		}
 	}
 
 	logger->info("\nShutting down session...\n");
 
-	sim_panel_destroy(simh_panel);
+	scanner->report_statistics(true);
+	precision_timer->report_statistics(true);
+	commands.report_statistics(true);
+	examine_cache.report_statistics(true);
+	subscriptions.report_statistics(true);
+	display_rate.report_statistics(true);
+	action_latency.report(true);
+	cpu_usage.report(true);
+
+	report_simulator_instances(config_entry->switch_code, process, true);
+
+	commands.finish();
+
+	bool keep_simulator = (warm_restart || simulator_instances > 1) && program_running && result != SessionResult::Exit;
+	bool background = keep_simulator && simulator_instances > 1;
+
+	// Switching to another configuration (R1) or shutting down: saved to be resumed later,
+	// unless it keeps running in the background
+	bool save_snapshot = snapshots && first_instruction_ns != 0 && !background &&
+		(result == SessionResult::ReloadConfigRestartSession || !program_running);
+
+	if((keep_simulator && !background) || save_snapshot) {
+		sim_panel_exec_halt(simh_panel);
+	}
+
+	if(save_snapshot) {
+		snapshots->save(binary_path, *config_entry, get_guest_time_s());
+	}
+
+	if(snapshots) {
+		snapshots->report_statistics(false);
+	}
+
+	// Handed to a later session without callbacks (the register storage is shared), unless the program ends
+	if(keep_simulator) {
+		sim_panel_set_display_callback_interval(simh_panel, nullptr, nullptr, 0);
+
+		kept_simulators.push_back({simh_panel, process, binary_path, config_entry->directory, config_entry->configuration_file,
+			config_entry->switch_code, subscriptions.get_subscribed(), background, first_instruction_ns, restored_guest_time_s,
+			monotonic_time_ns()});
+	}
+	else {
+		sim_panel_destroy(simh_panel);
+	}
+
+	close(register_event_fd);
+	register_event_fd = -1;
 
 	return result;
 }
 
+// =============================================================
+// Benchmark
+// =============================================================
+
+static double benchmark_scans(int scans) {
+	uint16_t switches[3];
+
+	auto start = std::chrono::steady_clock::now();
+
+	for(int i = 0; i < scans && program_running; i++) {
+		scanner->scan_switches(switches);
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return scans / elapsed.count();
+}
+
+static void run_benchmark(int scans) {
+	logger->info("[BENCHMARK] Scanning the switch matrix %d times per mode\n", scans);
+
+	// Before: every direction switch releases and re-requests the column lines
+	matrix->set_reconfigure_in_place(false);
+	double scans_rerequest = benchmark_scans(scans);
+
+	// After: direction switches reconfigure the existing column request
+	matrix->set_reconfigure_in_place(true);
+
+	uint64_t fallbacks = matrix->get_reconfigure_fallbacks();
+	double scans_reconfigure = benchmark_scans(scans);
+
+	fallbacks = matrix->get_reconfigure_fallbacks() - fallbacks;
+
+	logger->info("[BENCHMARK] Re-request lines:    %10.1f scans/s\n", scans_rerequest);
+	logger->info("[BENCHMARK] Reconfigure in place: %9.1f scans/s\n", scans_reconfigure);
+
+	if(fallbacks) {
+		logger->error("[BENCHMARK] %llu reconfigurations in place fell back to re-requesting the lines, no comparison\n",
+			(unsigned long long) fallbacks);
+		return;
+	}
+
+	logger->info("[BENCHMARK] Speedup: %.2fx\n", scans_reconfigure / scans_rerequest);
+}
+
 // =============================================================
 // Main
 // =============================================================
 
+// Sessions change directory, files written later need absolute paths
+static string absolute_path(const char *path) {
+	char directory[4096];
+
+	if(path[0] == '/' || !getcwd(directory, sizeof(directory))) {
+		return path;
+	}
+
+	return string(directory) + "/" + path;
+}
+
 static void print_usage(const char *program_name) {
 	fprintf(stderr, "Usage: %s [OPTIONS] <pdp11_binary> <config_file_full_path>\n", program_name);
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "  -d, --daemon     Run as daemon with syslog logging\n");
+	fprintf(stderr, "  -g, --gpio <backend>\n");
+	fprintf(stderr, "                   GPIO backend: gpiod (default), mmap or simulated\n");
+	fprintf(stderr, "  -m, --gpio-memory <path>\n");
+	fprintf(stderr, "                   GPIO registers for the mmap backend (default: /dev/gpiomem)\n");
+	fprintf(stderr, "  -f, --frame-rate <hz>\n");
+	fprintf(stderr, "                   LED refresh rate (default: %u, at most %u)\n", DEFAULT_FRAME_RATE, MAX_FRAME_RATE);
+	fprintf(stderr, "  -p, --rt-priority <priority>\n");
+	fprintf(stderr, "                   Run the LED refresh thread under SCHED_FIFO (1-99)\n");
+	fprintf(stderr, "  -c, --cpu <cpu>  Pin the LED refresh thread to a CPU\n");
+	fprintf(stderr, "  -D, --debounce <class>=<press_ms>[/<release_ms>]\n");
+	fprintf(stderr, "                   Debounce times for toggle (default: 20/20), momentary\n");
+	fprintf(stderr, "                   (default: 5/10) or encoder (default: 0/0) switches\n");
+	fprintf(stderr, "  -r, --scan-rates <row0_hz>,<row1_hz>,<row2_hz>\n");
+	fprintf(stderr, "                   Switch row read rates, 0 for every free gap (default: 25,100,0)\n");
+	fprintf(stderr, "  -a, --encoder-acceleration\n");
+	fprintf(stderr, "                   Turn R1/R2 faster to move more than one position per detent\n");
+	fprintf(stderr, "  -e, --examine-block <words>\n");
+	fprintf(stderr, "                   Words examined ahead during EXAM sequences, 1 to disable (default: %u, at most %u)\n", DEFAULT_EXAMINE_BLOCK_WORDS, MAX_EXAMINE_BLOCK_WORDS);
+	fprintf(stderr, "  -l, --load <file>[@<octal_address>]\n");
+	fprintf(stderr, "                   Deposit an absolute loader tape (or a raw image at the address)\n");
+	fprintf(stderr, "                   and start it instead of booting\n");
+	fprintf(stderr, "  -V, --verify-load\n");
+	fprintf(stderr, "                   Read the loaded image back and compare\n");
+	fprintf(stderr, "  -P, --profile <file>\n");
+	fprintf(stderr, "                   Sample the guest PC while running and write a profile to the file\n");
+	fprintf(stderr, "  -S, --profile-symbols <file>\n");
+	fprintf(stderr, "                   Symbol table (nm output) for kernel mode addresses in the profile\n");
+	fprintf(stderr, "  -I, --profile-interval <seconds>\n");
+	fprintf(stderr, "                   Time between profile writes (default: %u)\n", DEFAULT_PROFILE_INTERVAL_S);
+	fprintf(stderr, "  -u, --update-interval <min_ms>,<max_ms>\n");
+	fprintf(stderr, "                   Bounds of the simulator register update interval (default: %g,%g)\n",
+		DEFAULT_UPDATE_INTERVALS.min_interval_us / 1e3, DEFAULT_UPDATE_INTERVALS.max_interval_us / 1e3);
+	fprintf(stderr, "  -w, --warm-restart\n");
+	fprintf(stderr, "                   Keep the simulator connected across R1/R2 restarts of the same configuration\n");
+	fprintf(stderr, "  -s, --snapshots <directory>\n");
+	fprintf(stderr, "                   Resume each configuration entry from a saved simulator snapshot\n");
+	fprintf(stderr, "  -t, --snapshot-port <port>\n");
+	fprintf(stderr, "                   Remote console port of the simulator, used to save snapshots\n");
+	fprintf(stderr, "  -n, --instances <count>\n");
+	fprintf(stderr, "                   Keep up to <count> simulators running, R1 switches between them (default: 1)\n");
+	fprintf(stderr, "  -C, --simulator-cpus <list>\n");
+	fprintf(stderr, "                   CPUs for the simulators, e.g. 1-3 (default: all but the --cpu of the scanner)\n");
+	fprintf(stderr, "  -b, --benchmark <scans>\n");
+	fprintf(stderr, "                   Measure switch scans per second and exit\n");
 	fprintf(stderr, "  -h, --help       Show this help message\n");
 	fprintf(stderr, "\n");
 }
 
 int main(int argc, char *argv[]) {
 	bool run_as_daemon = false;
+	int benchmark_scan_count = 0;
+	const char *gpio_backend_name = "gpiod";
+	const char *gpio_memory_path = "/dev/gpiomem";
+	const char *load_path = nullptr;
+	const char *profile_path = nullptr;
+	const char *profile_symbols_path = nullptr;
+	int profile_interval_s = DEFAULT_PROFILE_INTERVAL_S;
+	const char *snapshot_directory = nullptr;
+	int snapshot_port = 0;
+
+	// Encoder rotation inputs on switch row 2: R1 on columns 8/9, R2 on columns 10/11
+	ScannerConfiguration scanner_configuration = {DEFAULT_FRAME_RATE, 0, -1, DEFAULT_DEBOUNCE, {{8, 9}, {10, 11}}, false, DEFAULT_SCAN_RATES};
 
 	// Parse command-line options
 	static struct option long_options[] = {
-		{"daemon", no_argument, 0, 'd'},
-		{"help",   no_argument, 0, 'h'},
+		{"daemon",      no_argument,       0, 'd'},
+		{"gpio",        required_argument, 0, 'g'},
+		{"gpio-memory", required_argument, 0, 'm'},
+		{"frame-rate",  required_argument, 0, 'f'},
+		{"rt-priority", required_argument, 0, 'p'},
+		{"cpu",         required_argument, 0, 'c'},
+		{"debounce",    required_argument, 0, 'D'},
+		{"scan-rates",  required_argument, 0, 'r'},
+		{"encoder-acceleration", no_argument, 0, 'a'},
+		{"examine-block", required_argument, 0, 'e'},
+		{"load",        required_argument, 0, 'l'},
+		{"verify-load", no_argument,       0, 'V'},
+		{"profile",     required_argument, 0, 'P'},
+		{"profile-symbols", required_argument, 0, 'S'},
+		{"profile-interval", required_argument, 0, 'I'},
+		{"update-interval", required_argument, 0, 'u'},
+		{"warm-restart", no_argument,      0, 'w'},
+		{"snapshots",   required_argument, 0, 's'},
+		{"snapshot-port", required_argument, 0, 't'},
+		{"instances",   required_argument, 0, 'n'},
+		{"simulator-cpus", required_argument, 0, 'C'},
+		{"benchmark",   required_argument, 0, 'b'},
+		{"help",        no_argument,       0, 'h'},
 		{0, 0, 0, 0}
 	};
 
 	int option_index = 0;
 	int c;
 
-	while((c = getopt_long(argc, argv, "dh", long_options, &option_index)) != -1) {
+	while((c = getopt_long(argc, argv, "dg:m:f:p:c:D:r:ae:l:VP:S:I:u:ws:t:n:C:b:h", long_options, &option_index)) != -1) {
 		switch(c) {
 			case 'd':
 				run_as_daemon = true;
 				break;
 
+			case 'g':
+				gpio_backend_name = optarg;
+				break;
+
+			case 'm':
+				gpio_memory_path = optarg;
+				break;
+
+			case 'f': {
+				char *end;
+				long frame_rate = strtol(optarg, &end, 10);
+
+				if(end == optarg || *end != '\0' || frame_rate <= 0 || frame_rate > MAX_FRAME_RATE) {
+					fprintf(stderr, "Error: Invalid frame rate: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				scanner_configuration.frame_rate = (unsigned int) frame_rate;
+				break;
+			}
+
+			case 'p':
+				scanner_configuration.realtime_priority = atoi(optarg);
+
+				if(scanner_configuration.realtime_priority < 1 || scanner_configuration.realtime_priority > 99) {
+					fprintf(stderr, "Error: Invalid real-time priority: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				break;
+
+			case 'c': {
+				char *end;
+				long cpu = strtol(optarg, &end, 10);
+
+				if(end == optarg || *end != '\0' || cpu < 0 || cpu >= get_cpu_limit()) {
+					fprintf(stderr, "Error: Invalid CPU: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				scanner_configuration.cpu = (int) cpu;
+				break;
+			}
+
+			case 'D':
+				if(!parse_debounce_option(optarg, scanner_configuration.debounce)) {
+					fprintf(stderr, "Error: Invalid debounce setting: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				break;
+
+			case 'r': {
+				unsigned int *rates = scanner_configuration.scan_policy.row_rates_hz;
+				char extra;
+
+				if(sscanf(optarg, "%u,%u,%u%c", &rates[0], &rates[1], &rates[2], &extra) != 3) {
+					fprintf(stderr, "Error: Invalid scan rates: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				break;
+			}
+
+			case 'a':
+				scanner_configuration.encoder_acceleration = true;
+				break;
+
+			case 'e':
+				if(atoi(optarg) <= 0 || atoi(optarg) > (int) MAX_EXAMINE_BLOCK_WORDS) {
+					fprintf(stderr, "Error: Invalid examine block: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				examine_block_words = atoi(optarg);
+				break;
+
+			case 'l':
+				load_path = optarg;
+				break;
+
+			case 'V':
+				verify_memory_image = true;
+				break;
+
+			case 'P':
+				profile_path = optarg;
+				break;
+
+			case 'S':
+				profile_symbols_path = optarg;
+				break;
+
+			case 'u':
+				if(!parse_update_interval_option(optarg, display_rate_configuration)) {
+					fprintf(stderr, "Error: Invalid update interval: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				break;
+
+			case 'w':
+				warm_restart = true;
+				break;
+
+			case 's':
+				snapshot_directory = optarg;
+				break;
+
+			case 't':
+				snapshot_port = atoi(optarg);
+
+				if(snapshot_port <= 0 || snapshot_port > 65535) {
+					fprintf(stderr, "Error: Invalid remote console port: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				break;
+
+			case 'I':
+				profile_interval_s = atoi(optarg);
+
+				if(profile_interval_s <= 0) {
+					fprintf(stderr, "Error: Invalid profile interval: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				break;
+
+			case 'n':
+				simulator_instances = (unsigned int) atoi(optarg);
+
+				if(atoi(optarg) <= 0) {
+					fprintf(stderr, "Error: Invalid number of simulator instances: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				break;
+
+			case 'C':
+				if(!parse_cpu_list(optarg, simulator_cpus)) {
+					fprintf(stderr, "Error: Invalid CPU list: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				use_simulator_cpus = true;
+				break;
+
+			case 'b':
+				benchmark_scan_count = atoi(optarg);
+
+				if(benchmark_scan_count <= 0) {
+					fprintf(stderr, "Error: Invalid scan count: %s\n\n", optarg);
+					print_usage(argv[0]);
+
+					return 1;
+				}
+
+				break;
+
 			case 'h':
 				print_usage(argv[0]);
 				return 0;
@@ -1081,6 +2426,26 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	// Benchmark mode needs only the GPIO hardware
+	if(benchmark_scan_count > 0) {
+		logger = new Logger();
+		logger->init(false, "frontpanel");
+
+		std::signal(SIGINT, signal_handler);
+		std::signal(SIGTERM, signal_handler);
+
+		if(init_gpio(gpio_backend_name, gpio_memory_path, scanner_configuration)) {
+			run_benchmark(benchmark_scan_count);
+		}
+
+		finish_gpio();
+
+		logger->finish();
+		delete logger;
+
+		return 0;
+	}
+
 	// Check for required positional arguments
 	if(optind + 2 > argc) {
 		fprintf(stderr, "Error: Missing required arguments\n\n");
@@ -1092,10 +2457,79 @@ int main(int argc, char *argv[]) {
 	const char *pdp11_binary = argv[optind];
 	const char *config_file = argv[optind + 1];
 
+	// Simulators stay off the CPU of the scanner thread, unless told otherwise
+	long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(!use_simulator_cpus && scanner_configuration.cpu >= 0 && cpu_count > 1) {
+		CPU_ZERO(&simulator_cpus);
+
+		for(long cpu = 0; cpu < cpu_count && cpu < CPU_SETSIZE; cpu++) {
+			if(cpu != scanner_configuration.cpu) {
+				CPU_SET(cpu, &simulator_cpus);
+			}
+		}
+
+		use_simulator_cpus = true;
+	}
+
 	// Initialize logger
 	logger = new Logger();
 	logger->init(run_as_daemon, "frontpanel");
 
+	// Read before the sessions change directory
+	if(load_path) {
+		string path = load_path;
+		size_t separator = path.rfind('@');
+
+		if(separator == string::npos) {
+			memory_image = new MemoryImage(path);
+		}
+		else {
+			memory_image = new MemoryImage(path.substr(0, separator), strtoul(path.c_str() + separator + 1, nullptr, 8));
+		}
+
+		if(!memory_image->init()) {
+			finish_frontpanel();
+
+			logger->finish();
+			delete logger;
+			return 1;
+		}
+	}
+
+	if(snapshot_directory) {
+		if(snapshot_port == 0) {
+			logger->error("--snapshots needs the remote console port (--snapshot-port)\n");
+
+			finish_frontpanel();
+
+			logger->finish();
+			delete logger;
+			return 1;
+		}
+
+		// Background simulators are neither saved nor reachable on the one remote console port
+		if(simulator_instances > 1) {
+			logger->error("--snapshots cannot be combined with --instances\n");
+
+			finish_frontpanel();
+
+			logger->finish();
+			delete logger;
+			return 1;
+		}
+
+		snapshots = new SnapshotStore(absolute_path(snapshot_directory), snapshot_port);
+
+		if(!snapshots->init()) {
+			finish_frontpanel();
+
+			logger->finish();
+			delete logger;
+			return 1;
+		}
+	}
+
 	// Daemonize if requested
 	if(run_as_daemon) {
 		logger->info("Daemonizing process\n");
@@ -1103,6 +2537,8 @@ int main(int argc, char *argv[]) {
 		if(!daemonize(nullptr)) {
 			logger->error("Failed to daemonize process\n");
 
+			finish_frontpanel();
+
 			delete logger;
 			return 1;
 		}
@@ -1110,10 +2546,31 @@ int main(int argc, char *argv[]) {
 		logger->info("Daemon started successfully\n");
 	}
 
+	// The writer thread is started here, it would not survive the forks of daemonize()
+	if(profile_path) {
+		profiler = new PCProfiler(absolute_path(profile_path), profile_symbols_path ? absolute_path(profile_symbols_path) : "", profile_interval_s);
+
+		if(!profiler->init()) {
+			finish_frontpanel();
+
+			logger->finish();
+			delete logger;
+			return 1;
+		}
+	}
+
 	std::signal(SIGINT, signal_handler);
 	std::signal(SIGTERM, signal_handler);
+	std::signal(SIGUSR1, snapshot_signal_handler);
+
+	if(!init_gpio(gpio_backend_name, gpio_memory_path, scanner_configuration)) {
+		finish_frontpanel();
+		logger->finish();
+		delete logger;
+		return 1;
+	}
 
-	init_gpio();
+	scanner->start();
 
 	// Load configuration file
 	Configuration config(config_file);
@@ -1121,16 +2578,21 @@ int main(int argc, char *argv[]) {
 	if(!config.init()) {
 		logger->error("ERROR: Failed to load configuration file\n");
 
-		finish_gpio();
+		finish_frontpanel();
 		logger->finish();
 		delete logger;
 		return 1;
 	}
 
+	// R2 asks for a fresh boot, everything else resumes a background simulator or a snapshot if there is one
+	bool allow_resume = true;
+
 	while(program_running) {
+		session_request_ns = monotonic_time_ns();
+
 		// Read switch register to determine configuration
-		bool switches[3][12];
-		read_state_switches(switches);
+		uint16_t switches[3];
+		scanner->wait_switches(switches, WAIT_FIRST_SCAN_MS);
 		decode_state_switches(switches, panel);
 
 		uint32_t switch_code = panel.switch_state & 0x3FFFFF;
@@ -1165,7 +2627,9 @@ int main(int argc, char *argv[]) {
 		logger->info("[CONFIG] Changed to directory: %s\n", entry->directory.c_str());
 
 		// Run session with this configuration
-		SessionResult result = run_session(pdp11_binary, entry);
+		SessionResult result = run_session(pdp11_binary, entry, allow_resume);
+
+		allow_resume = (result != SessionResult::RestartSession);
 
 		switch(result) {
 			case SessionResult::Exit:
@@ -1188,7 +2652,9 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	finish_gpio();
+	destroy_kept_simulators();
+
+	finish_frontpanel();
 
 	logger->info("\nClean exit\n");
 
@@ -1,16 +1,11 @@
 #ifndef GPIO_H
 #define GPIO_H
 
-#include <string>
 #include <vector>
 #include <cstdint>
 
-using std::string;
 using std::vector;
 
-struct gpiod_chip;
-struct gpiod_line_request;
-
 enum class PinMode {
 	Input,
 	Output,
@@ -25,90 +20,64 @@ enum class PullMode {
 };
 
 // =============================================================
-// GPIOChip: Manages a single GPIO chip
+// GPIOGroup: Multiple pins controlled together
 // =============================================================
 
-class GPIOChip {
-private:
-	string chip_path;
-	gpiod_chip *chip;
-
-	bool initialized;
-
+class GPIOGroup {
 public:
-	GPIOChip(const string &chip_path);
-	~GPIOChip();
+	virtual ~GPIOGroup() {}
 
-	bool init();
-	void finish();
+	virtual bool init() = 0;
+	virtual void finish() = 0;
 
-	bool is_initialized() const { return initialized; }
+	bool pin_mode(PinMode mode, PullMode pull = PullMode::None) { return pin_mode_mask(get_all_mask(), mode, pull); }
 
-	gpiod_chip* get_chip() { return chip; }
-};
+	// Changes the mode of the pins in the mask only, leaving the others as they are
+	virtual bool pin_mode_mask(uint32_t mask, PinMode mode, PullMode pull = PullMode::None) = 0;
 
-// =============================================================
-// GPIO: Single pin control
-// =============================================================
+	virtual bool pin_set(int index, bool flag) = 0;
+	virtual bool pin_get(int index) = 0;
 
-class GPIO {
-private:
-	GPIOChip *chip;
-	unsigned int pin_number;
+	bool pins_set_all(const bool *flags);
+	bool pins_get_all(bool *flags);
 
-	PinMode current_mode;
-	PullMode current_pull;
+	// Bit i of the mask corresponds to pin i of the group (at most 32 pins)
+	virtual bool pins_set_mask(uint32_t mask) = 0;
+	virtual bool pins_get_mask(uint32_t &mask) = 0;
 
-	gpiod_line_request *request;
-	bool initialized;
+	// Drives only the pins in the mask, in a single request
+	virtual bool pins_set_masked(uint32_t mask, uint32_t values) = 0;
 
-public:
-	GPIO(GPIOChip *chip, unsigned int pin_number);
-	~GPIO();
+	virtual int get_pin_count() const = 0;
 
-	bool init();
-	void finish();
+	uint32_t get_all_mask() const { return (get_pin_count() >= 32) ? 0xFFFFFFFF : ((1u << get_pin_count()) - 1); }
 
-	bool pin_mode(PinMode mode, PullMode pull = PullMode::None);
-	bool pin_set(bool flag);
-	bool pin_get();
+	// Only meaningful for backends that can either reconfigure or re-request lines
+	virtual void set_reconfigure_in_place(bool flag) { (void) flag; }
 
-	bool is_initialized() const { return initialized; }
+	// Reconfigurations in place that failed and re-requested the lines instead
+	virtual uint64_t get_reconfigure_fallbacks() const { return 0; }
+
+	virtual bool is_initialized() const = 0;
 };
 
 // =============================================================
-// GPIOGroup: Multiple pins controlled together
+// GPIOBackend: Source of GPIO groups (hardware or simulated)
 // =============================================================
 
-class GPIOGroup {
-private:
-	GPIOChip *chip;
-	vector<unsigned int> pin_numbers;
-
-	PinMode current_mode;
-	PullMode current_pull;
-
-	gpiod_line_request *request;
-	bool initialized;
-
+class GPIOBackend {
 public:
-	GPIOGroup(GPIOChip *chip, const vector<unsigned int> &pins);
-	~GPIOGroup();
-
-	bool init();
-	void finish();
-
-	bool pin_mode(PinMode mode, PullMode pull = PullMode::None);
+	virtual ~GPIOBackend() {}
 
-	bool pin_set(int index, bool flag);
-	bool pin_get(int index);
+	virtual bool init() = 0;
+	virtual void finish() = 0;
 
-	bool pins_set_all(const bool *flags);
-	bool pins_get_all(bool *flags);
+	// The caller owns the returned group
+	virtual GPIOGroup* create_group(const vector<unsigned int> &pins) = 0;
 
-	int get_pin_count() const { return pin_numbers.size(); }
+	virtual const char* get_name() const = 0;
 
-	bool is_initialized() const { return initialized; }
+	virtual bool is_initialized() const = 0;
 };
 
 #endif // GPIO_H
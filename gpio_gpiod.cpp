@@ -0,0 +1,416 @@
+#include "gpio_gpiod.h"
+
+#include "logger.h"
+
+#include <cerrno>
+#include <cstring>
+
+using std::string;
+using std::vector;
+
+// =============================================================
+// GPIOChip
+// =============================================================
+
+GPIOChip::GPIOChip(const string &chip_path):
+	chip_path(chip_path),
+	chip(nullptr),
+	initialized(false) {
+}
+
+GPIOChip::~GPIOChip() {
+	finish();
+}
+
+bool GPIOChip::init() {
+	if(initialized) {
+		return true;
+	}
+
+	chip = gpiod_chip_open(chip_path.c_str());
+
+	if(!chip) {
+		return false;
+	}
+
+	initialized = true;
+
+	return true;
+}
+
+void GPIOChip::finish() {
+	if(chip) {
+		gpiod_chip_close(chip);
+		chip = nullptr;
+	}
+
+	initialized = false;
+}
+
+GPIOGroup* GPIOChip::create_group(const vector<unsigned int> &pins) {
+	return new GPIODGroup(this, pins);
+}
+
+// =============================================================
+// GPIODGroup
+// =============================================================
+
+static gpiod_line_settings* create_line_settings(PinMode mode, PullMode pull) {
+	gpiod_line_settings *settings = gpiod_line_settings_new();
+
+	if(!settings) {
+		return nullptr;
+	}
+
+	switch(mode) {
+		case PinMode::Input:
+			gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+			break;
+
+		case PinMode::Output:
+			gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+			gpiod_line_settings_set_drive(settings, GPIOD_LINE_DRIVE_PUSH_PULL);
+			gpiod_line_settings_set_output_value(settings, GPIOD_LINE_VALUE_INACTIVE);
+			break;
+
+		case PinMode::OpenDrain:
+			gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+			gpiod_line_settings_set_drive(settings, GPIOD_LINE_DRIVE_OPEN_DRAIN);
+			gpiod_line_settings_set_output_value(settings, GPIOD_LINE_VALUE_INACTIVE);
+			break;
+
+		case PinMode::OpenSource:
+			gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+			gpiod_line_settings_set_drive(settings, GPIOD_LINE_DRIVE_OPEN_SOURCE);
+			gpiod_line_settings_set_output_value(settings, GPIOD_LINE_VALUE_INACTIVE);
+			break;
+	}
+
+	switch(pull) {
+		case PullMode::None:
+			gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_DISABLED);
+			break;
+
+		case PullMode::PullUp:
+			gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_PULL_UP);
+			break;
+
+		case PullMode::PullDown:
+			gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_PULL_DOWN);
+			break;
+	}
+
+	return settings;
+}
+
+static uint8_t encode_pin_config(PinMode mode, PullMode pull) {
+	return static_cast<uint8_t>(static_cast<int>(mode) * 3 + static_cast<int>(pull));
+}
+
+GPIODGroup::GPIODGroup(GPIOChip *chip, const vector<unsigned int> &pins):
+	chip(chip),
+	pin_numbers(pins),
+	pin_configs(pins.size(), encode_pin_config(PinMode::Input, PullMode::None)),
+	input_mask(0),
+	output_values(0),
+	request(nullptr),
+	request_config(nullptr),
+	values(pins.size()),
+	subset_offsets(pins.size()),
+	requested_configs(pins.size()),
+	line_settings{},
+	reconfigure_in_place(true),
+	reconfigure_fallbacks{0},
+	initialized(false) {
+	input_mask = get_all_mask();
+}
+
+GPIODGroup::~GPIODGroup() {
+	finish();
+}
+
+bool GPIODGroup::init() {
+	if(initialized) {
+		return true;
+	}
+
+	if(!chip || !chip->is_initialized() || pin_numbers.size() > 32) {
+		return false;
+	}
+
+	request_config = gpiod_request_config_new();
+
+	if(!request_config) {
+		return false;
+	}
+
+	gpiod_request_config_set_consumer(request_config, "GPIOGroup");
+
+	initialized = true;
+
+	return true;
+}
+
+void GPIODGroup::finish() {
+	if(request) {
+		gpiod_line_request_release(request);
+		request = nullptr;
+	}
+
+	for(auto &configuration : line_configs) {
+		gpiod_line_config_free(configuration.line_config);
+	}
+
+	line_configs.clear();
+
+	for(auto &line_settings_mode : line_settings) {
+		for(auto &settings : line_settings_mode) {
+			if(settings) {
+				gpiod_line_settings_free(settings);
+				settings = nullptr;
+			}
+		}
+	}
+
+	if(request_config) {
+		gpiod_request_config_free(request_config);
+		request_config = nullptr;
+	}
+
+	initialized = false;
+}
+
+gpiod_line_settings* GPIODGroup::get_line_settings(uint8_t pin_config) {
+	gpiod_line_settings *&settings = line_settings[pin_config / 3][pin_config % 3];
+
+	if(!settings) {
+		settings = create_line_settings(static_cast<PinMode>(pin_config / 3), static_cast<PullMode>(pin_config % 3));
+	}
+
+	return settings;
+}
+
+GPIODGroup::LineConfiguration* GPIODGroup::get_line_config(const vector<uint8_t> &configs) {
+	for(auto &configuration : line_configs) {
+		if(configuration.pin_configs == configs) {
+			return &configuration;
+		}
+	}
+
+	LineConfiguration configuration;
+
+	configuration.pin_configs = configs;
+	configuration.line_config = gpiod_line_config_new();
+
+	if(!configuration.line_config) {
+		return nullptr;
+	}
+
+	// Lines are added in pin order, one run of pins with the same settings at a time: the request
+	// keeps the order of the line configuration, value arrays are indexed by pin, and reconfiguring
+	// in place needs the lines in the order they were requested
+	for(size_t first = 0; first < configs.size();) {
+		size_t last = first + 1;
+
+		while(last < configs.size() && configs[last] == configs[first]) {
+			last++;
+		}
+
+		gpiod_line_settings *settings = get_line_settings(configs[first]);
+
+		if(!settings || gpiod_line_config_add_line_settings(configuration.line_config, &pin_numbers[first], last - first, settings)) {
+			gpiod_line_config_free(configuration.line_config);
+			return nullptr;
+		}
+
+		first = last;
+	}
+
+	line_configs.push_back(configuration);
+
+	return &line_configs.back();
+}
+
+bool GPIODGroup::pin_mode_mask(uint32_t mask, PinMode mode, PullMode pull) {
+	if(!initialized || !chip || pin_numbers.empty()) {
+		return false;
+	}
+
+	uint8_t pin_config = encode_pin_config(mode, pull);
+
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		requested_configs[i] = ((mask >> i) & 1) ? pin_config : pin_configs[i];
+	}
+
+	if(request && requested_configs == pin_configs) {
+		return true;
+	}
+
+	LineConfiguration *configuration = get_line_config(requested_configs);
+
+	if(!configuration) {
+		return false;
+	}
+
+	// Keep driving the last values on the output pins across the change
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		values[i] = ((output_values >> i) & 1) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+	}
+
+	gpiod_line_config_set_output_values(configuration->line_config, values.data(), values.size());
+
+	bool reconfigured = false;
+
+	// Fast path: change direction/bias on the lines we already hold
+	if(request && reconfigure_in_place) {
+		reconfigured = (gpiod_line_request_reconfigure_lines(request, configuration->line_config) == 0);
+
+		// Falling back costs the whole point of the fast path (and glitches the outputs), so it is counted and reported
+		if(!reconfigured) {
+			if(reconfigure_fallbacks == 0) {
+				logger->error("[GPIO] Reconfiguring lines in place failed: %s; re-requesting them instead\n", strerror(errno));
+			}
+
+			reconfigure_fallbacks.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if(!reconfigured) {
+		if(request) {
+			gpiod_line_request_release(request);
+			request = nullptr;
+		}
+
+		request = gpiod_chip_request_lines(chip->get_chip(), request_config, configuration->line_config);
+
+		if(!request) {
+			return false;
+		}
+	}
+
+	pin_configs = requested_configs;
+
+	input_mask = 0;
+
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		if(static_cast<PinMode>(pin_configs[i] / 3) == PinMode::Input) {
+			input_mask |= (1u << i);
+		}
+	}
+
+	return true;
+}
+
+bool GPIODGroup::pin_set(int index, bool flag) {
+	if(!initialized || !request || index < 0 || index >= (int)pin_numbers.size()) {
+		return false;
+	}
+
+	if(input_mask & (1u << index)) {
+		return false;
+	}
+
+	gpiod_line_value value = flag ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+
+	int return_value = gpiod_line_request_set_value(request, pin_numbers[index], value);
+
+	if(return_value != 0) {
+		return false;
+	}
+
+	output_values = flag ? (output_values | (1u << index)) : (output_values & ~(1u << index));
+
+	return true;
+}
+
+bool GPIODGroup::pin_get(int index) {
+	if(!initialized || !request || index < 0 || index >= (int)pin_numbers.size()) {
+		return false;
+	}
+
+	gpiod_line_value value = gpiod_line_request_get_value(request, pin_numbers[index]);
+
+	return (value == GPIOD_LINE_VALUE_ACTIVE);
+}
+
+bool GPIODGroup::pins_set_mask(uint32_t mask) {
+	if(!initialized || !request) {
+		return false;
+	}
+
+	if(input_mask) {
+		return false;
+	}
+
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		values[i] = ((mask >> i) & 1) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+	}
+
+	int return_value = gpiod_line_request_set_values(request, values.data());
+
+	if(return_value != 0) {
+		return false;
+	}
+
+	output_values = mask & get_all_mask();
+
+	return true;
+}
+
+bool GPIODGroup::pins_get_mask(uint32_t &mask) {
+	if(!initialized || !request) {
+		return false;
+	}
+
+	int return_value = gpiod_line_request_get_values(request, values.data());
+
+	if(return_value != 0) {
+		return false;
+	}
+
+	mask = 0;
+
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		if(values[i] == GPIOD_LINE_VALUE_ACTIVE) {
+			mask |= (1u << i);
+		}
+	}
+
+	return true;
+}
+
+bool GPIODGroup::pins_set_masked(uint32_t mask, uint32_t flags) {
+	if(!initialized || !request) {
+		return false;
+	}
+
+	mask &= get_all_mask();
+
+	if(mask & input_mask) {
+		return false;
+	}
+
+	size_t count = 0;
+
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		if((mask >> i) & 1) {
+			subset_offsets[count] = pin_numbers[i];
+			values[count] = ((flags >> i) & 1) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+			count++;
+		}
+	}
+
+	if(count == 0) {
+		return true;
+	}
+
+	int return_value = gpiod_line_request_set_values_subset(request, count, subset_offsets.data(), values.data());
+
+	if(return_value != 0) {
+		return false;
+	}
+
+	output_values = (output_values & ~mask) | (flags & mask);
+
+	return true;
+}
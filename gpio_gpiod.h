@@ -0,0 +1,110 @@
+#ifndef GPIO_GPIOD_H
+#define GPIO_GPIOD_H
+
+#include "gpio.h"
+
+#include <gpiod.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using std::string;
+using std::vector;
+
+// =============================================================
+// GPIOChip: Manages a single GPIO chip (libgpiod backend)
+// =============================================================
+
+class GPIOChip : public GPIOBackend {
+private:
+	string chip_path;
+	gpiod_chip *chip;
+
+	bool initialized;
+
+public:
+	GPIOChip(const string &chip_path);
+	~GPIOChip();
+
+	bool init() override;
+	void finish() override;
+
+	GPIOGroup* create_group(const vector<unsigned int> &pins) override;
+
+	const char* get_name() const override { return "gpiod"; }
+
+	bool is_initialized() const override { return initialized; }
+
+	gpiod_chip* get_chip() { return chip; }
+};
+
+// =============================================================
+// GPIODGroup: Multiple pins in a single line request
+// =============================================================
+
+class GPIODGroup : public GPIOGroup {
+private:
+	// Line configuration for one combination of per-pin modes
+	struct LineConfiguration {
+		vector<uint8_t> pin_configs;
+		gpiod_line_config *line_config;
+	};
+
+	GPIOChip *chip;
+	vector<unsigned int> pin_numbers;
+
+	// Per-pin (PinMode, PullMode), encoded as mode * 3 + pull
+	vector<uint8_t> pin_configs;
+
+	uint32_t input_mask;
+	uint32_t output_values;
+
+	gpiod_line_request *request;
+	gpiod_request_config *request_config;
+
+	// Scratch buffers for bulk reads/writes, sized once in the constructor
+	vector<gpiod_line_value> values;
+	vector<unsigned int> subset_offsets;
+	vector<uint8_t> requested_configs;
+
+	// Settings are built once per (PinMode, PullMode), line configurations once per pin mode combination
+	gpiod_line_settings *line_settings[4][3];
+	vector<LineConfiguration> line_configs;
+
+	// Switch direction by reconfiguring the existing request instead of re-requesting the lines
+	bool reconfigure_in_place;
+	// Written by the scanner thread, read by the statistics
+	std::atomic<uint64_t> reconfigure_fallbacks;
+
+	bool initialized;
+
+	gpiod_line_settings* get_line_settings(uint8_t pin_config);
+	LineConfiguration* get_line_config(const vector<uint8_t> &configs);
+
+public:
+	GPIODGroup(GPIOChip *chip, const vector<unsigned int> &pins);
+	~GPIODGroup();
+
+	bool init() override;
+	void finish() override;
+
+	bool pin_mode_mask(uint32_t mask, PinMode mode, PullMode pull = PullMode::None) override;
+
+	bool pin_set(int index, bool flag) override;
+	bool pin_get(int index) override;
+
+	bool pins_set_mask(uint32_t mask) override;
+	bool pins_get_mask(uint32_t &mask) override;
+
+	bool pins_set_masked(uint32_t mask, uint32_t values) override;
+
+	int get_pin_count() const override { return pin_numbers.size(); }
+
+	void set_reconfigure_in_place(bool flag) override { reconfigure_in_place = flag; }
+	uint64_t get_reconfigure_fallbacks() const override { return reconfigure_fallbacks.load(std::memory_order_relaxed); }
+
+	bool is_initialized() const override { return initialized; }
+};
+
+#endif // GPIO_GPIOD_H
@@ -0,0 +1,349 @@
+#include "gpio_mmap.h"
+
+#include <fstream>
+#include <iterator>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+
+// Register offsets, in 32-bit words from the start of the GPIO block
+constexpr unsigned int REGISTER_GPFSEL0            = 0x00 / 4;
+constexpr unsigned int REGISTER_GPSET0             = 0x1C / 4;
+constexpr unsigned int REGISTER_GPCLR0             = 0x28 / 4;
+constexpr unsigned int REGISTER_GPLEV0             = 0x34 / 4;
+constexpr unsigned int REGISTER_GPPUD              = 0x94 / 4;
+constexpr unsigned int REGISTER_GPPUDCLK0          = 0x98 / 4;
+constexpr unsigned int REGISTER_GPIO_PUP_PDN_CNTRL = 0xE4 / 4;
+
+// The legacy pull-up/down sequence needs 150 cycles between steps
+constexpr unsigned int WAIT_PULL_CLOCK_US = 1;
+
+// Only bank 0 (GPIO 0-31) is supported, which covers the panel pins
+constexpr unsigned int MAX_PIN = 31;
+
+// =============================================================
+// GPIOMemory
+// =============================================================
+
+GPIOMemory::GPIOMemory(const string &memory_path):
+	memory_path(memory_path),
+	file_descriptor(-1),
+	registers(nullptr),
+	emulate_levels(false),
+	bcm2711_pulls(false),
+	pull_known_mask(0),
+	pull_up_mask(0),
+	pull_down_mask(0),
+	initialized(false) {
+}
+
+GPIOMemory::~GPIOMemory() {
+	finish();
+}
+
+bool GPIOMemory::init() {
+	if(initialized) {
+		return true;
+	}
+
+	file_descriptor = open(memory_path.c_str(), O_RDWR | O_SYNC | O_CLOEXEC);
+
+	if(file_descriptor < 0) {
+		return false;
+	}
+
+	struct stat file_status;
+
+	if(fstat(file_descriptor, &file_status) != 0) {
+		finish();
+		return false;
+	}
+
+	// A register image in a regular file: make it large enough and emulate the level register
+	if(S_ISREG(file_status.st_mode)) {
+		if(file_status.st_size < (off_t) MAP_SIZE && ftruncate(file_descriptor, MAP_SIZE) != 0) {
+			finish();
+			return false;
+		}
+
+		emulate_levels = true;
+	}
+	else {
+		// The BCM2711 (Pi 4) replaced the GPPUD/GPPUDCLK sequence with direct pull registers
+		std::ifstream compatible("/proc/device-tree/compatible");
+		string model((std::istreambuf_iterator<char>(compatible)), std::istreambuf_iterator<char>());
+
+		if(model.find("bcm2712") != string::npos) {
+			// The Pi 5 GPIO block lives in the RP1 and has a different layout
+			finish();
+			return false;
+		}
+
+		bcm2711_pulls = (model.find("bcm2711") != string::npos);
+	}
+
+	void *mapping = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+
+	if(mapping == MAP_FAILED) {
+		finish();
+		return false;
+	}
+
+	registers = static_cast<volatile uint32_t*>(mapping);
+
+	// Whatever was configured before is not known
+	pull_known_mask = 0;
+	pull_up_mask = 0;
+	pull_down_mask = 0;
+
+	initialized = true;
+
+	return true;
+}
+
+void GPIOMemory::finish() {
+	if(registers) {
+		munmap(const_cast<uint32_t*>(registers), MAP_SIZE);
+		registers = nullptr;
+	}
+
+	if(file_descriptor >= 0) {
+		close(file_descriptor);
+		file_descriptor = -1;
+	}
+
+	initialized = false;
+}
+
+GPIOGroup* GPIOMemory::create_group(const vector<unsigned int> &pins) {
+	return new GPIOMemoryGroup(this, pins);
+}
+
+void GPIOMemory::set_function(unsigned int pin, bool output) {
+	volatile uint32_t &function_select = registers[REGISTER_GPFSEL0 + pin / 10];
+	unsigned int shift = (pin % 10) * 3;
+
+	function_select = (function_select & ~(7u << shift)) | ((output ? 1u : 0u) << shift);
+}
+
+void GPIOMemory::set_pull(uint32_t pin_mask, PullMode pull) {
+	uint32_t same_pull_mask = (pull == PullMode::PullUp) ? pull_up_mask :
+		(pull == PullMode::PullDown) ? pull_down_mask : ~(pull_up_mask | pull_down_mask);
+
+	pin_mask &= ~(pull_known_mask & same_pull_mask);
+
+	if(!pin_mask) {
+		return;
+	}
+
+	pull_known_mask |= pin_mask;
+	pull_up_mask = (pull == PullMode::PullUp) ? (pull_up_mask | pin_mask) : (pull_up_mask & ~pin_mask);
+	pull_down_mask = (pull == PullMode::PullDown) ? (pull_down_mask | pin_mask) : (pull_down_mask & ~pin_mask);
+
+	if(bcm2711_pulls) {
+		// 2 bits per pin: 0 = none, 1 = pull-up, 2 = pull-down
+		uint32_t value = (pull == PullMode::PullUp) ? 1 : (pull == PullMode::PullDown) ? 2 : 0;
+
+		for(unsigned int pin = 0; pin <= MAX_PIN; pin++) {
+			if(!((pin_mask >> pin) & 1)) {
+				continue;
+			}
+
+			volatile uint32_t &control = registers[REGISTER_GPIO_PUP_PDN_CNTRL + pin / 16];
+			unsigned int shift = (pin % 16) * 2;
+
+			control = (control & ~(3u << shift)) | (value << shift);
+		}
+
+		return;
+	}
+
+	// Legacy sequence: 0 = none, 1 = pull-down, 2 = pull-up
+	registers[REGISTER_GPPUD] = (pull == PullMode::PullUp) ? 2 : (pull == PullMode::PullDown) ? 1 : 0;
+	usleep(WAIT_PULL_CLOCK_US);
+
+	registers[REGISTER_GPPUDCLK0] = pin_mask;
+	usleep(WAIT_PULL_CLOCK_US);
+
+	registers[REGISTER_GPPUD] = 0;
+	registers[REGISTER_GPPUDCLK0] = 0;
+}
+
+void GPIOMemory::write_set_clear(uint32_t set_mask, uint32_t clear_mask) {
+	// Clear first: for the LED matrix this lowers the columns before a row is enabled
+	if(clear_mask) {
+		registers[REGISTER_GPCLR0] = clear_mask;
+	}
+
+	if(set_mask) {
+		registers[REGISTER_GPSET0] = set_mask;
+	}
+
+	if(emulate_levels) {
+		registers[REGISTER_GPLEV0] = (registers[REGISTER_GPLEV0] & ~clear_mask) | set_mask;
+	}
+}
+
+uint32_t GPIOMemory::read_levels() {
+	return registers[REGISTER_GPLEV0];
+}
+
+// =============================================================
+// GPIOMemoryGroup
+// =============================================================
+
+GPIOMemoryGroup::GPIOMemoryGroup(GPIOMemory *memory, const vector<unsigned int> &pins):
+	memory(memory),
+	pin_numbers(pins),
+	pin_bits{},
+	input_mask(0),
+	driven_mask(0),
+	initialized(false) {
+	input_mask = get_all_mask();
+}
+
+GPIOMemoryGroup::~GPIOMemoryGroup() {
+	finish();
+}
+
+bool GPIOMemoryGroup::init() {
+	if(initialized) {
+		return true;
+	}
+
+	if(!memory || !memory->is_initialized() || pin_numbers.size() > 32) {
+		return false;
+	}
+
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		if(pin_numbers[i] > MAX_PIN) {
+			return false;
+		}
+
+		pin_bits[i] = 1u << pin_numbers[i];
+	}
+
+	driven_mask = 0;
+
+	initialized = true;
+
+	return true;
+}
+
+void GPIOMemoryGroup::finish() {
+	initialized = false;
+}
+
+uint32_t GPIOMemoryGroup::to_bank_mask(uint32_t group_mask) const {
+	uint32_t bank_mask = 0;
+
+	while(group_mask) {
+		int index = __builtin_ctz(group_mask);
+
+		bank_mask |= pin_bits[index];
+		group_mask &= group_mask - 1;
+	}
+
+	return bank_mask;
+}
+
+bool GPIOMemoryGroup::pin_mode_mask(uint32_t mask, PinMode mode, PullMode pull) {
+	if(!initialized || pin_numbers.empty()) {
+		return false;
+	}
+
+	// The function select only offers push-pull outputs
+	if(mode == PinMode::OpenDrain || mode == PinMode::OpenSource) {
+		return false;
+	}
+
+	mask &= get_all_mask();
+
+	bool output = (mode == PinMode::Output);
+
+	// Like the libgpiod backend: outputs drive the level last set on them (the output latch
+	// is not changed by the function select), and pins never driven start inactive (low)
+	if(output) {
+		memory->write_set_clear(0, to_bank_mask(mask & ~driven_mask));
+		driven_mask |= mask;
+	}
+	// Pulls only matter for inputs, outputs keep theirs so that switching back and forth
+	// does not rewrite them
+	else {
+		memory->set_pull(to_bank_mask(mask), pull);
+	}
+
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		if((mask >> i) & 1) {
+			memory->set_function(pin_numbers[i], output);
+		}
+	}
+
+	input_mask = output ? (input_mask & ~mask) : (input_mask | mask);
+
+	return true;
+}
+
+bool GPIOMemoryGroup::pin_set(int index, bool flag) {
+	if(!initialized || index < 0 || index >= (int)pin_numbers.size()) {
+		return false;
+	}
+
+	return pins_set_masked(1u << index, flag ? (1u << index) : 0);
+}
+
+bool GPIOMemoryGroup::pin_get(int index) {
+	if(!initialized || index < 0 || index >= (int)pin_numbers.size()) {
+		return false;
+	}
+
+	return (memory->read_levels() & pin_bits[index]) != 0;
+}
+
+bool GPIOMemoryGroup::pins_set_mask(uint32_t mask) {
+	if(!initialized || input_mask) {
+		return false;
+	}
+
+	return pins_set_masked(get_all_mask(), mask);
+}
+
+bool GPIOMemoryGroup::pins_get_mask(uint32_t &mask) {
+	if(!initialized) {
+		return false;
+	}
+
+	uint32_t levels = memory->read_levels();
+
+	mask = 0;
+
+	for(size_t i = 0; i < pin_numbers.size(); i++) {
+		if(levels & pin_bits[i]) {
+			mask |= (1u << i);
+		}
+	}
+
+	return true;
+}
+
+bool GPIOMemoryGroup::pins_set_masked(uint32_t mask, uint32_t values) {
+	if(!initialized) {
+		return false;
+	}
+
+	mask &= get_all_mask();
+
+	if(mask & input_mask) {
+		return false;
+	}
+
+	memory->write_set_clear(to_bank_mask(mask & values), to_bank_mask(mask & ~values));
+	driven_mask |= mask;
+
+	return true;
+}
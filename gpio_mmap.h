@@ -0,0 +1,105 @@
+#ifndef GPIO_MMAP_H
+#define GPIO_MMAP_H
+
+#include "gpio.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using std::string;
+using std::vector;
+
+// =============================================================
+// GPIOMemory: BCM2835/BCM2711 GPIO registers mapped into memory
+// =============================================================
+
+// Maps the GPIO register block (as exposed by /dev/gpiomem) and drives pins with plain
+// stores to the set/clear registers. A regular file can stand in for the device; in that
+// case the level register is updated from the set/clear writes, so outputs read back
+
+class GPIOMemory : public GPIOBackend {
+private:
+	static constexpr size_t MAP_SIZE = 4096;
+
+	string memory_path;
+	int file_descriptor;
+
+	volatile uint32_t *registers;
+
+	bool emulate_levels;
+	bool bcm2711_pulls;
+
+	// Pulls written since init(), so that only changes go through the slow legacy sequence
+	uint32_t pull_known_mask;
+	uint32_t pull_up_mask;
+	uint32_t pull_down_mask;
+
+	bool initialized;
+
+	friend class GPIOMemoryGroup;
+
+	void set_function(unsigned int pin, bool output);
+	void set_pull(uint32_t pin_mask, PullMode pull);
+
+	void write_set_clear(uint32_t set_mask, uint32_t clear_mask);
+	uint32_t read_levels();
+
+public:
+	GPIOMemory(const string &memory_path);
+	~GPIOMemory();
+
+	bool init() override;
+	void finish() override;
+
+	GPIOGroup* create_group(const vector<unsigned int> &pins) override;
+
+	const char* get_name() const override { return "mmap"; }
+
+	bool is_initialized() const override { return initialized; }
+};
+
+// =============================================================
+// GPIOMemoryGroup: GPIOGroup over memory-mapped registers
+// =============================================================
+
+class GPIOMemoryGroup : public GPIOGroup {
+private:
+	GPIOMemory *memory;
+	vector<unsigned int> pin_numbers;
+
+	// Bank 0 bit of each pin in the group
+	uint32_t pin_bits[32];
+
+	uint32_t input_mask;
+
+	// Pins driven, or configured as outputs, since init()
+	uint32_t driven_mask;
+
+	bool initialized;
+
+	uint32_t to_bank_mask(uint32_t group_mask) const;
+
+public:
+	GPIOMemoryGroup(GPIOMemory *memory, const vector<unsigned int> &pins);
+	~GPIOMemoryGroup();
+
+	bool init() override;
+	void finish() override;
+
+	bool pin_mode_mask(uint32_t mask, PinMode mode, PullMode pull = PullMode::None) override;
+
+	bool pin_set(int index, bool flag) override;
+	bool pin_get(int index) override;
+
+	bool pins_set_mask(uint32_t mask) override;
+	bool pins_get_mask(uint32_t &mask) override;
+
+	bool pins_set_masked(uint32_t mask, uint32_t values) override;
+
+	int get_pin_count() const override { return pin_numbers.size(); }
+
+	bool is_initialized() const override { return initialized; }
+};
+
+#endif // GPIO_MMAP_H
@@ -0,0 +1,400 @@
+#include "gpio_simulated.h"
+#include "timing.h"
+
+using std::vector;
+using std::lock_guard;
+using std::mutex;
+
+// =============================================================
+// SimulatedPanel
+// =============================================================
+
+SimulatedPanel::SimulatedPanel(const vector<unsigned int> &led_row_pins, const vector<unsigned int> &switch_row_pins, const vector<unsigned int> &col_pins, uint64_t settle_ns):
+	led_row_pins(led_row_pins),
+	switch_row_pins(switch_row_pins),
+	col_pins(col_pins),
+	pins{},
+	switches{},
+	settle_ns(settle_ns),
+	led_on_time_ns{},
+	last_update_ns(0),
+	transition_next(0),
+	transition_count(0),
+	initialized(false) {
+}
+
+SimulatedPanel::~SimulatedPanel() {
+	finish();
+}
+
+bool SimulatedPanel::init() {
+	if(initialized) {
+		return true;
+	}
+
+	if(led_row_pins.size() != 6 || switch_row_pins.size() != 3 || col_pins.size() != 12) {
+		return false;
+	}
+
+	for(auto &pin : pins) {
+		pin.output = false;
+		pin.pull = PullMode::None;
+		pin.level = true;
+		pin.settled_level = true;
+		pin.pending_level = true;
+		pin.pending_since_ns = 0;
+	}
+
+	transitions.assign(DEFAULT_TRANSITION_CAPACITY, PinTransition{});
+	transition_next = 0;
+	transition_count = 0;
+
+	last_update_ns = monotonic_time_ns();
+
+	initialized = true;
+
+	return true;
+}
+
+void SimulatedPanel::finish() {
+	initialized = false;
+}
+
+GPIOGroup* SimulatedPanel::create_group(const vector<unsigned int> &group_pins) {
+	return new SimulatedGroup(this, group_pins);
+}
+
+void SimulatedPanel::accumulate_led_time(uint64_t now) {
+	uint64_t elapsed = now - last_update_ns;
+
+	last_update_ns = now;
+
+	for(int row = 0; row < 6; row++) {
+		const PinState &row_pin = pins[led_row_pins[row]];
+
+		if(!row_pin.output || !row_pin.level) {
+			continue;
+		}
+
+		for(int col = 0; col < 12; col++) {
+			const PinState &col_pin = pins[col_pins[col]];
+
+			if(col_pin.output && !col_pin.level) {
+				led_on_time_ns[row][col] += elapsed;
+			}
+		}
+	}
+}
+
+void SimulatedPanel::update_columns(uint64_t now) {
+	for(int col = 0; col < 12; col++) {
+		PinState &col_pin = pins[col_pins[col]];
+
+		if(col_pin.output) {
+			continue;
+		}
+
+		// Floating inputs are treated as high, like the pulled-up case
+		bool level = (col_pin.pull != PullMode::PullDown);
+
+		for(int row = 0; row < 3; row++) {
+			const PinState &row_pin = pins[switch_row_pins[row]];
+
+			if(row_pin.output && !row_pin.level && switches[row][col]) {
+				level = false;
+			}
+		}
+
+		if(level != col_pin.pending_level) {
+			col_pin.pending_level = level;
+			col_pin.pending_since_ns = now;
+		}
+	}
+}
+
+void SimulatedPanel::record_transition(uint64_t now, unsigned int pin) {
+	PinTransition &transition = transitions[transition_next];
+
+	transition.timestamp_ns = now;
+	transition.pin = pin;
+	transition.output = pins[pin].output;
+	transition.level = pins[pin].level;
+
+	transition_next = (transition_next + 1) % transitions.size();
+	transition_count++;
+}
+
+bool SimulatedPanel::set_modes(const vector<unsigned int> &group_pins, uint32_t mask, PinMode mode, PullMode pull) {
+	lock_guard<mutex> guard(lock);
+
+	if(!initialized) {
+		return false;
+	}
+
+	uint64_t now = monotonic_time_ns();
+
+	accumulate_led_time(now);
+
+	for(size_t i = 0; i < group_pins.size(); i++) {
+		if(!((mask >> i) & 1)) {
+			continue;
+		}
+
+		PinState &pin = pins[group_pins[i]];
+		bool output = (mode != PinMode::Input);
+
+		pin.pull = pull;
+
+		if(pin.output != output) {
+			pin.output = output;
+
+			// Lines start driving inactive (low), inputs start from whatever was on the line
+			if(output) {
+				pin.level = false;
+			}
+			else {
+				pin.settled_level = pin.level;
+				pin.pending_level = pin.level;
+				pin.pending_since_ns = now;
+			}
+
+			record_transition(now, group_pins[i]);
+		}
+	}
+
+	update_columns(now);
+
+	return true;
+}
+
+bool SimulatedPanel::set_levels(const vector<unsigned int> &group_pins, uint32_t mask, uint32_t values) {
+	lock_guard<mutex> guard(lock);
+
+	if(!initialized) {
+		return false;
+	}
+
+	// Like a single line request: an input in the mask rejects the whole write, nothing is driven
+	for(size_t i = 0; i < group_pins.size(); i++) {
+		if(((mask >> i) & 1) && !pins[group_pins[i]].output) {
+			return false;
+		}
+	}
+
+	uint64_t now = monotonic_time_ns();
+
+	accumulate_led_time(now);
+
+	for(size_t i = 0; i < group_pins.size(); i++) {
+		if(!((mask >> i) & 1)) {
+			continue;
+		}
+
+		PinState &pin = pins[group_pins[i]];
+		bool level = (values >> i) & 1;
+
+		if(pin.level != level) {
+			pin.level = level;
+			record_transition(now, group_pins[i]);
+		}
+	}
+
+	update_columns(now);
+
+	return true;
+}
+
+uint32_t SimulatedPanel::get_levels(const vector<unsigned int> &group_pins) {
+	lock_guard<mutex> guard(lock);
+
+	uint64_t now = monotonic_time_ns();
+	uint32_t levels = 0;
+
+	for(size_t i = 0; i < group_pins.size(); i++) {
+		PinState &pin = pins[group_pins[i]];
+		bool level = pin.level;
+
+		if(!pin.output) {
+			if(now - pin.pending_since_ns >= settle_ns) {
+				pin.settled_level = pin.pending_level;
+			}
+
+			level = pin.settled_level;
+		}
+
+		if(level) {
+			levels |= (1u << i);
+		}
+	}
+
+	return levels;
+}
+
+void SimulatedPanel::set_switch(int row, int col, bool closed) {
+	lock_guard<mutex> guard(lock);
+
+	if(row < 0 || row >= 3 || col < 0 || col >= 12) {
+		return;
+	}
+
+	switches[row][col] = closed;
+
+	update_columns(monotonic_time_ns());
+}
+
+void SimulatedPanel::set_switch_register(uint32_t value) {
+	for(int bit = 0; bit < 22; bit++) {
+		set_switch(bit / 12, bit % 12, (value >> bit) & 1);
+	}
+}
+
+bool SimulatedPanel::is_led_lit(int row, int col) {
+	lock_guard<mutex> guard(lock);
+
+	if(row < 0 || row >= 6 || col < 0 || col >= 12) {
+		return false;
+	}
+
+	const PinState &row_pin = pins[led_row_pins[row]];
+	const PinState &col_pin = pins[col_pins[col]];
+
+	return row_pin.output && row_pin.level && col_pin.output && !col_pin.level;
+}
+
+uint64_t SimulatedPanel::get_led_on_time_ns(int row, int col) {
+	lock_guard<mutex> guard(lock);
+
+	if(row < 0 || row >= 6 || col < 0 || col >= 12) {
+		return 0;
+	}
+
+	accumulate_led_time(monotonic_time_ns());
+
+	return led_on_time_ns[row][col];
+}
+
+uint64_t SimulatedPanel::get_transitions(vector<PinTransition> &output) {
+	lock_guard<mutex> guard(lock);
+
+	output.clear();
+
+	size_t retained = (transition_count < transitions.size()) ? transition_count : transitions.size();
+	size_t first = (transition_next + transitions.size() - retained) % transitions.size();
+
+	for(size_t i = 0; i < retained; i++) {
+		output.push_back(transitions[(first + i) % transitions.size()]);
+	}
+
+	return transition_count;
+}
+
+void SimulatedPanel::clear_transitions() {
+	lock_guard<mutex> guard(lock);
+
+	transition_next = 0;
+	transition_count = 0;
+}
+
+// =============================================================
+// SimulatedGroup
+// =============================================================
+
+SimulatedGroup::SimulatedGroup(SimulatedPanel *panel, const vector<unsigned int> &pins):
+	panel(panel),
+	pin_numbers(pins),
+	input_mask(0),
+	initialized(false) {
+	input_mask = get_all_mask();
+}
+
+SimulatedGroup::~SimulatedGroup() {
+	finish();
+}
+
+bool SimulatedGroup::init() {
+	if(initialized) {
+		return true;
+	}
+
+	if(!panel || !panel->is_initialized() || pin_numbers.size() > 32) {
+		return false;
+	}
+
+	for(unsigned int pin : pin_numbers) {
+		if(pin >= SimulatedPanel::MAX_PINS) {
+			return false;
+		}
+	}
+
+	initialized = true;
+
+	return true;
+}
+
+void SimulatedGroup::finish() {
+	initialized = false;
+}
+
+bool SimulatedGroup::pin_mode_mask(uint32_t mask, PinMode mode, PullMode pull) {
+	if(!initialized || pin_numbers.empty()) {
+		return false;
+	}
+
+	mask &= get_all_mask();
+
+	if(!panel->set_modes(pin_numbers, mask, mode, pull)) {
+		return false;
+	}
+
+	input_mask = (mode == PinMode::Input) ? (input_mask | mask) : (input_mask & ~mask);
+
+	return true;
+}
+
+bool SimulatedGroup::pin_set(int index, bool flag) {
+	if(!initialized || index < 0 || index >= (int)pin_numbers.size()) {
+		return false;
+	}
+
+	return pins_set_masked(1u << index, flag ? (1u << index) : 0);
+}
+
+bool SimulatedGroup::pin_get(int index) {
+	if(!initialized || index < 0 || index >= (int)pin_numbers.size()) {
+		return false;
+	}
+
+	return (panel->get_levels(pin_numbers) >> index) & 1;
+}
+
+bool SimulatedGroup::pins_set_mask(uint32_t mask) {
+	if(!initialized || input_mask) {
+		return false;
+	}
+
+	return panel->set_levels(pin_numbers, get_all_mask(), mask);
+}
+
+bool SimulatedGroup::pins_get_mask(uint32_t &mask) {
+	if(!initialized) {
+		return false;
+	}
+
+	mask = panel->get_levels(pin_numbers);
+
+	return true;
+}
+
+bool SimulatedGroup::pins_set_masked(uint32_t mask, uint32_t values) {
+	if(!initialized) {
+		return false;
+	}
+
+	mask &= get_all_mask();
+
+	if(mask & input_mask) {
+		return false;
+	}
+
+	return panel->set_levels(pin_numbers, mask, values);
+}
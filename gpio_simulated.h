@@ -0,0 +1,135 @@
+#ifndef GPIO_SIMULATED_H
+#define GPIO_SIMULATED_H
+
+#include "gpio.h"
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+using std::vector;
+
+// =============================================================
+// SimulatedPanel: In-process model of the PiDP-11 matrix
+// =============================================================
+
+// 6x12 LED matrix: an LED is lit while its row pin is driven high and its column pin is driven low
+// 3x12 switch matrix: a closed switch pulls its column low while its row pin is driven low,
+// and column inputs only see a change once it has been stable for the settle time
+
+struct PinTransition {
+	uint64_t timestamp_ns;
+	unsigned int pin;
+	bool output;
+	bool level;
+};
+
+class SimulatedPanel : public GPIOBackend {
+private:
+	static constexpr unsigned int MAX_PINS = 64;
+	static constexpr size_t DEFAULT_TRANSITION_CAPACITY = 65536;
+
+	struct PinState {
+		bool output;
+		PullMode pull;
+		bool level;
+
+		// Column inputs: level visible to readers, and the level it is settling towards
+		bool settled_level;
+		bool pending_level;
+		uint64_t pending_since_ns;
+	};
+
+	vector<unsigned int> led_row_pins;
+	vector<unsigned int> switch_row_pins;
+	vector<unsigned int> col_pins;
+
+	PinState pins[MAX_PINS];
+
+	bool switches[3][12];
+	uint64_t settle_ns;
+
+	// Accumulated lit time per LED
+	uint64_t led_on_time_ns[6][12];
+	uint64_t last_update_ns;
+
+	// Bounded ring of pin transitions
+	vector<PinTransition> transitions;
+	size_t transition_next;
+	uint64_t transition_count;
+
+	std::mutex lock;
+
+	bool initialized;
+
+	void accumulate_led_time(uint64_t now);
+	void update_columns(uint64_t now);
+	void record_transition(uint64_t now, unsigned int pin);
+
+	friend class SimulatedGroup;
+
+	// Bulk pin access for SimulatedGroup, applied as a single transaction
+	bool set_modes(const vector<unsigned int> &group_pins, uint32_t mask, PinMode mode, PullMode pull);
+	bool set_levels(const vector<unsigned int> &group_pins, uint32_t mask, uint32_t values);
+	uint32_t get_levels(const vector<unsigned int> &group_pins);
+
+public:
+	SimulatedPanel(const vector<unsigned int> &led_row_pins, const vector<unsigned int> &switch_row_pins, const vector<unsigned int> &col_pins, uint64_t settle_ns);
+	~SimulatedPanel();
+
+	bool init() override;
+	void finish() override;
+
+	GPIOGroup* create_group(const vector<unsigned int> &pins) override;
+
+	const char* get_name() const override { return "simulated"; }
+
+	bool is_initialized() const override { return initialized; }
+
+	// Test controls
+	void set_switch(int row, int col, bool closed);
+	void set_switch_register(uint32_t value);
+
+	bool is_led_lit(int row, int col);
+	uint64_t get_led_on_time_ns(int row, int col);
+
+	// Returns the retained transitions, oldest first, and the total count since init()
+	uint64_t get_transitions(vector<PinTransition> &output);
+	void clear_transitions();
+};
+
+// =============================================================
+// SimulatedGroup: GPIOGroup view over SimulatedPanel pins
+// =============================================================
+
+class SimulatedGroup : public GPIOGroup {
+private:
+	SimulatedPanel *panel;
+	vector<unsigned int> pin_numbers;
+
+	uint32_t input_mask;
+	bool initialized;
+
+public:
+	SimulatedGroup(SimulatedPanel *panel, const vector<unsigned int> &pins);
+	~SimulatedGroup();
+
+	bool init() override;
+	void finish() override;
+
+	bool pin_mode_mask(uint32_t mask, PinMode mode, PullMode pull = PullMode::None) override;
+
+	bool pin_set(int index, bool flag) override;
+	bool pin_get(int index) override;
+
+	bool pins_set_mask(uint32_t mask) override;
+	bool pins_get_mask(uint32_t &mask) override;
+
+	bool pins_set_masked(uint32_t mask, uint32_t values) override;
+
+	int get_pin_count() const override { return pin_numbers.size(); }
+
+	bool is_initialized() const override { return initialized; }
+};
+
+#endif // GPIO_SIMULATED_H
@@ -0,0 +1,152 @@
+#include "memory_image.h"
+#include "logger.h"
+
+#include <fstream>
+#include <iterator>
+
+using std::ifstream;
+
+MemoryImage::MemoryImage(const string &path):
+	path{path},
+	raw{false},
+	raw_address{0},
+	byte_count{0},
+	has_start{false},
+	start_address{0},
+	initialized{false} {
+}
+
+MemoryImage::MemoryImage(const string &path, uint32_t load_address):
+	path{path},
+	raw{true},
+	raw_address{load_address},
+	byte_count{0},
+	has_start{false},
+	start_address{0},
+	initialized{false} {
+}
+
+bool MemoryImage::init() {
+	if(initialized) {
+		return true;
+	}
+
+	ifstream file(path, std::ios::binary);
+
+	if(!file.is_open()) {
+		logger->error("[LOAD] Failed to open image: %s\n", path.c_str());
+		return false;
+	}
+
+	vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	words.clear();
+	byte_count = 0;
+	has_start = false;
+
+	if(!(raw ? read_raw(data) : read_absolute_loader(data))) {
+		return false;
+	}
+
+	initialized = true;
+
+	return true;
+}
+
+bool MemoryImage::get_start_address(uint32_t &address) const {
+	if(!has_start) {
+		return false;
+	}
+
+	address = start_address;
+
+	return true;
+}
+
+void MemoryImage::set_byte(uint32_t address, uint8_t value) {
+	ImageWord &word = words[address & ~1u];
+
+	if(address & 1) {
+		word.value = (word.value & 0x00FF) | (value << 8);
+	}
+	else {
+		word.value = (word.value & 0xFF00) | value;
+	}
+
+	word.byte_mask |= (address & 1) ? 2 : 1;
+	byte_count++;
+}
+
+// Blocks of: 001 000, byte count (low, high, includes the 6 header bytes), load address (low, high),
+// data, checksum (all bytes of the block including it add up to 0); blocks may be separated by
+// zeros (leader/trailer). A block without data carries the transfer address
+bool MemoryImage::read_absolute_loader(const vector<uint8_t> &data) {
+	size_t position = 0;
+
+	while(true) {
+		while(position < data.size() && data[position] == 0) {
+			position++;
+		}
+
+		if(position == data.size()) {
+			logger->info("[LOAD] %s: no transfer block, the image will not be started\n", path.c_str());
+			return true;
+		}
+
+		if(data[position] != 1 || position + 6 > data.size() || data[position + 1] != 0) {
+			logger->error("[LOAD] %s: bad block header at offset %zu\n", path.c_str(), position);
+			return false;
+		}
+
+		size_t count = data[position + 2] | (data[position + 3] << 8);
+		uint32_t address = data[position + 4] | (data[position + 5] << 8);
+
+		if(count < 6 || position + count + 1 > data.size()) {
+			logger->error("[LOAD] %s: truncated block at offset %zu\n", path.c_str(), position);
+			return false;
+		}
+
+		uint8_t checksum = 0;
+
+		for(size_t i = 0; i <= count; i++) {
+			checksum += data[position + i];
+		}
+
+		if(checksum != 0) {
+			logger->error("[LOAD] %s: checksum error in block at offset %zu\n", path.c_str(), position);
+			return false;
+		}
+
+		if(count == 6) {
+			// An odd transfer address means: do not start
+			if(!(address & 1)) {
+				has_start = true;
+				start_address = address;
+			}
+
+			return true;
+		}
+
+		for(size_t i = 6; i < count; i++) {
+			set_byte(address + (i - 6), data[position + i]);
+		}
+
+		position += count + 1;
+	}
+}
+
+bool MemoryImage::read_raw(const vector<uint8_t> &data) {
+	if(data.empty()) {
+		logger->error("[LOAD] %s: empty image\n", path.c_str());
+		return false;
+	}
+
+	for(size_t i = 0; i < data.size(); i++) {
+		set_byte((raw_address + i) & 0x3FFFFF, data[i]);
+	}
+
+	has_start = true;
+	start_address = raw_address & ~1u;
+
+	return true;
+}
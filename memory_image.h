@@ -0,0 +1,67 @@
+#ifndef MEMORY_IMAGE_H
+#define MEMORY_IMAGE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using std::map;
+using std::string;
+using std::vector;
+
+// =============================================================
+// Memory image
+// =============================================================
+
+struct ImageWord {
+	uint16_t value;
+
+	// Bit 0: low byte present, bit 1: high byte present
+	uint8_t byte_mask;
+};
+
+// Contents of a PDP-11 absolute loader (.LDA/.BIN) tape or of a raw binary image,
+// as 16-bit words keyed by their (even) address
+
+class MemoryImage {
+private:
+	string path;
+
+	bool raw;
+	uint32_t raw_address;
+
+	map<uint32_t, ImageWord> words;
+	uint64_t byte_count;
+
+	bool has_start;
+	uint32_t start_address;
+
+	bool initialized;
+
+	bool read_absolute_loader(const vector<uint8_t> &data);
+	bool read_raw(const vector<uint8_t> &data);
+
+	void set_byte(uint32_t address, uint8_t value);
+
+public:
+	// Absolute loader format
+	MemoryImage(const string &path);
+
+	// Raw image, loaded and started at the address
+	MemoryImage(const string &path, uint32_t load_address);
+
+	bool init();
+
+	const map<uint32_t, ImageWord>& get_words() const { return words; }
+	uint64_t get_byte_count() const { return byte_count; }
+
+	// False when the tape has no transfer address (or an odd one, meaning halt after loading)
+	bool get_start_address(uint32_t &address) const;
+
+	const string& get_path() const { return path; }
+
+	bool is_initialized() const { return initialized; }
+};
+
+#endif // MEMORY_IMAGE_H
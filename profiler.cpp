@@ -0,0 +1,218 @@
+#include "profiler.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using std::ifstream;
+using std::stringstream;
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+PCProfiler::PCProfiler(const string &path, const string &symbols_path, unsigned int interval_s):
+	path{path},
+	symbols_path{symbols_path},
+	interval_s{interval_s},
+	samples{0},
+	running{false},
+	initialized{false} {
+}
+
+PCProfiler::~PCProfiler() {
+	finish();
+}
+
+bool PCProfiler::init() {
+	if(initialized) {
+		return true;
+	}
+
+	if(!symbols_path.empty() && !load_symbols()) {
+		return false;
+	}
+
+	counts.reset(new std::atomic<uint32_t>[SPACES * BUCKETS]);
+
+	for(unsigned i = 0; i < SPACES * BUCKETS; i++) {
+		counts[i].store(0, std::memory_order_relaxed);
+	}
+
+	samples.store(0, std::memory_order_relaxed);
+
+	running = true;
+	writer = std::thread(&PCProfiler::run, this);
+
+	initialized = true;
+
+	return true;
+}
+
+void PCProfiler::finish() {
+	if(!initialized) {
+		return;
+	}
+
+	{
+		lock_guard<mutex> guard(lock);
+
+		running = false;
+	}
+
+	stop_signal.notify_one();
+
+	if(writer.joinable()) {
+		writer.join();
+	}
+
+	if(write_profile()) {
+		logger->info("[PROFILE] Wrote %llu PC samples to %s\n", (unsigned long long) samples.load(), path.c_str());
+	}
+
+	initialized = false;
+}
+
+void PCProfiler::run() {
+	unique_lock<mutex> guard(lock);
+
+	while(running) {
+		if(stop_signal.wait_for(guard, std::chrono::seconds(interval_s), [this] { return !running; })) {
+			break;
+		}
+
+		guard.unlock();
+		write_profile();
+		guard.lock();
+	}
+}
+
+// =============================================================
+// Symbols
+// =============================================================
+
+// One symbol per line: <octal address> [<type>] <name>, as printed by nm
+// Lines that do not start with an octal address are skipped
+bool PCProfiler::load_symbols() {
+	ifstream file(symbols_path);
+
+	if(!file.is_open()) {
+		logger->error("[PROFILE] Failed to open symbol table: %s\n", symbols_path.c_str());
+		return false;
+	}
+
+	string line;
+
+	while(std::getline(file, line)) {
+		stringstream stream(line);
+		string address_field, field, name;
+
+		if(!(stream >> address_field) || address_field.find_first_not_of("01234567") != string::npos) {
+			continue;
+		}
+
+		while(stream >> field) {
+			name = field;
+		}
+
+		if(name.empty()) {
+			continue;
+		}
+
+		// Too long for an address: not a symbol line
+		errno = 0;
+		unsigned long long address = strtoull(address_field.c_str(), nullptr, 8);
+
+		if(errno == ERANGE || address > UINT32_MAX) {
+			continue;
+		}
+
+		symbols.push_back({(uint32_t) address, name});
+	}
+
+	std::sort(symbols.begin(), symbols.end(), [](const Symbol &a, const Symbol &b) { return a.address < b.address; });
+
+	logger->info("[PROFILE] Loaded %zu symbols from %s\n", symbols.size(), symbols_path.c_str());
+
+	return true;
+}
+
+string PCProfiler::symbolize(uint32_t address) const {
+	auto next = std::upper_bound(symbols.begin(), symbols.end(), address, [](uint32_t value, const Symbol &symbol) { return value < symbol.address; });
+
+	if(next == symbols.begin()) {
+		return "";
+	}
+
+	const Symbol &symbol = *(next - 1);
+
+	if(symbol.address == address) {
+		return symbol.name;
+	}
+
+	char offset[16];
+	snprintf(offset, sizeof(offset), "+%o", address - symbol.address);
+
+	return symbol.name + offset;
+}
+
+// =============================================================
+// Output
+// =============================================================
+
+bool PCProfiler::write_profile() {
+	static const char *mode_names[4] = {"kernel", "super", "illegal", "user"};
+
+	struct Entry {
+		uint32_t count;
+		unsigned index;
+	};
+
+	vector<Entry> entries;
+	uint64_t total = 0;
+
+	for(unsigned i = 0; i < SPACES * BUCKETS; i++) {
+		uint32_t count = counts[i].load(std::memory_order_relaxed);
+
+		if(count) {
+			entries.push_back({count, i});
+			total += count;
+		}
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.count > b.count; });
+
+	// Replaced in one step, so a reader never sees a partial profile
+	string temporary_path = path + ".tmp";
+	FILE *file = fopen(temporary_path.c_str(), "w");
+
+	if(!file) {
+		logger->error("[PROFILE] Failed to write profile: %s\n", temporary_path.c_str());
+		return false;
+	}
+
+	fprintf(file, "# PC profile: %llu samples, %u-byte buckets\n", (unsigned long long) total, 1u << BUCKET_SHIFT);
+	fprintf(file, "# mode space address count percent symbol\n");
+
+	for(const Entry &entry: entries) {
+		unsigned space = entry.index / BUCKETS;
+		uint32_t address = (entry.index % BUCKETS) << BUCKET_SHIFT;
+
+		fprintf(file, "%s %c %06o %u %.2f%% %s\n", mode_names[space / 2], (space & 1) ? 'D' : 'I', address,
+			entry.count, 100.0 * entry.count / total, (space / 2 == 0) ? symbolize(address).c_str() : "");
+	}
+
+	fclose(file);
+
+	if(rename(temporary_path.c_str(), path.c_str()) != 0) {
+		logger->error("[PROFILE] Failed to replace profile: %s\n", path.c_str());
+		return false;
+	}
+
+	return true;
+}
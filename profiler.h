@@ -0,0 +1,80 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+using std::string;
+using std::vector;
+
+// =============================================================
+// Guest PC profiler
+// =============================================================
+
+// Histogram of PC samples keyed by processor mode (PSW<15:14>), I/D space and
+// address bucket of the 16-bit virtual PC; sample() is lock-free and is called
+// from the simulator display callback, a writer thread saves the profile periodically
+
+class PCProfiler {
+private:
+	static constexpr unsigned BUCKET_SHIFT = 2;
+	static constexpr unsigned BUCKETS = 0x10000 >> BUCKET_SHIFT;
+
+	// Kernel, supervisor, (illegal), user, each with I and D space
+	static constexpr unsigned SPACES = 4 * 2;
+
+	struct Symbol {
+		uint32_t address;
+		string name;
+	};
+
+	string path;
+	string symbols_path;
+	unsigned int interval_s;
+
+	// Indexed by space * BUCKETS + bucket
+	std::unique_ptr<std::atomic<uint32_t>[]> counts;
+	std::atomic<uint64_t> samples;
+
+	// Sorted by address, applied to kernel mode samples
+	vector<Symbol> symbols;
+
+	std::mutex lock;
+	std::condition_variable stop_signal;
+
+	std::thread writer;
+	bool running;
+	bool initialized;
+
+	bool load_symbols();
+	string symbolize(uint32_t address) const;
+
+	void run();
+
+public:
+	PCProfiler(const string &path, const string &symbols_path, unsigned int interval_s);
+	~PCProfiler();
+
+	bool init();
+	void finish();
+
+	void sample(uint16_t pc, uint16_t psw, uint8_t id_mode) {
+		unsigned space = ((psw >> 14) & 3) * 2 + (id_mode & 1);
+
+		counts[space * BUCKETS + (pc >> BUCKET_SHIFT)].fetch_add(1, std::memory_order_relaxed);
+		samples.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Text profile, hottest buckets first
+	bool write_profile();
+
+	bool is_initialized() const { return initialized; }
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,124 @@
+#include "register_subscriptions.h"
+#include "logger.h"
+#include "timing.h"
+
+#include <cstdio>
+
+RegisterSubscriptions::RegisterSubscriptions():
+	report_time_ns{monotonic_time_ns()},
+	report_bytes{0},
+	additions{0} {
+	read_process_bytes(report_bytes);
+}
+
+uint32_t RegisterSubscriptions::define(const string &name, size_t size, void *storage) {
+	registers.push_back({name, size, storage});
+	states.push_back(State::Unsubscribed);
+
+	return 1u << (registers.size() - 1);
+}
+
+void RegisterSubscriptions::subscribed(uint32_t mask) {
+	for(size_t i = 0; i < registers.size(); i++) {
+		if(mask & (1u << i)) {
+			states[i] = State::Subscribed;
+		}
+	}
+}
+
+vector<RegisterSubscriptions::Register> RegisterSubscriptions::take_missing(uint32_t required, bool halted) {
+	vector<Register> missing;
+
+	for(size_t i = 0; i < registers.size(); i++) {
+		if(!(required & (1u << i))) {
+			continue;
+		}
+
+		if(states[i] == State::Unsubscribed || (states[i] == State::Failed && halted)) {
+			states[i] = State::Adding;
+			missing.push_back(registers[i]);
+		}
+	}
+
+	return missing;
+}
+
+void RegisterSubscriptions::added(const string &name, bool success) {
+	for(size_t i = 0; i < registers.size(); i++) {
+		if(registers[i].name == name && states[i] == State::Adding) {
+			states[i] = success ? State::Subscribed : State::Failed;
+			additions += success;
+
+			return;
+		}
+	}
+}
+
+uint32_t RegisterSubscriptions::get_subscribed() const {
+	uint32_t mask = 0;
+
+	for(size_t i = 0; i < registers.size(); i++) {
+		if(states[i] == State::Subscribed) {
+			mask |= (1u << i);
+		}
+	}
+
+	return mask;
+}
+
+// Bytes read by the whole process (rchar), which is dominated by the simulator connection
+bool RegisterSubscriptions::read_process_bytes(uint64_t &bytes) {
+	FILE *file = fopen("/proc/self/io", "r");
+
+	if(!file) {
+		return false;
+	}
+
+	char line[128];
+	bool found = false;
+
+	while(fgets(line, sizeof(line), file)) {
+		unsigned long long value;
+
+		if(sscanf(line, "rchar: %llu", &value) == 1) {
+			bytes = value;
+			found = true;
+			break;
+		}
+	}
+
+	fclose(file);
+
+	return found;
+}
+
+void RegisterSubscriptions::report_statistics(bool reset) {
+	string names;
+
+	for(size_t i = 0; i < registers.size(); i++) {
+		if(states[i] == State::Subscribed) {
+			names += (names.empty() ? "" : " ") + registers[i].name;
+		}
+	}
+
+	logger->info("[REGISTERS] Subscribed: %s (%llu registers added)\n", names.c_str(), (unsigned long long) additions);
+
+	uint64_t now_ns = monotonic_time_ns();
+	uint64_t bytes;
+
+	if(!read_process_bytes(bytes)) {
+		logger->info("[REGISTERS] Simulator connection traffic unavailable (no /proc/self/io)\n");
+		return;
+	}
+
+	double elapsed_s = (now_ns - report_time_ns) / (double) NS_PER_SECOND;
+
+	logger->info("[REGISTERS] Simulator connection: %.0f bytes/s over %.1f s (all reads of the process)\n",
+		(bytes - report_bytes) / elapsed_s, elapsed_s);
+
+	if(reset) {
+		report_time_ns = now_ns;
+		report_bytes = bytes;
+		additions = 0;
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef REGISTER_SUBSCRIPTIONS_H
+#define REGISTER_SUBSCRIPTIONS_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+using std::string;
+using std::vector;
+
+// =============================================================
+// Register subscriptions
+// =============================================================
+
+// Tracks which simulator registers are shipped with every display callback
+// The set only grows: sim_frontpanel cannot drop a register, so registers are added
+// the first time the panel needs them instead of all up front
+// Only used by the panel logic thread
+
+class RegisterSubscriptions {
+public:
+	struct Register {
+		string name;
+		size_t size;
+		void *storage;
+	};
+
+private:
+	enum class State {
+		Unsubscribed,
+		Adding,
+		Subscribed,
+		// Adding failed (the simulator may refuse while running), retried once halted
+		Failed
+	};
+
+	vector<Register> registers;
+	vector<State> states;
+
+	// Connection traffic since the last report
+	uint64_t report_time_ns;
+	uint64_t report_bytes;
+
+	uint64_t additions;
+
+	static bool read_process_bytes(uint64_t &bytes);
+
+public:
+	RegisterSubscriptions();
+
+	// Returns the bit of the register in the masks below
+	uint32_t define(const string &name, size_t size, void *storage);
+
+	// For registers subscribed directly
+	void subscribed(uint32_t mask);
+
+	// Registers in <required> that should be added now (marked as being added)
+	vector<Register> take_missing(uint32_t required, bool halted);
+
+	void added(const string &name, bool success);
+
+	uint32_t get_subscribed() const;
+
+	void report_statistics(bool reset);
+};
+
+#endif // REGISTER_SUBSCRIPTIONS_H
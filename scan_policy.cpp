@@ -0,0 +1,81 @@
+#include "scan_policy.h"
+
+#include "timing.h"
+
+ScanPolicy::ScanPolicy():
+	interval_ns{},
+	last_read_ns{},
+	boost_until_ns{},
+	last_columns{},
+	read_once{} {
+}
+
+void ScanPolicy::configure(const ScanPolicyConfiguration &configuration) {
+	for(int row = 0; row < 3; row++) {
+		interval_ns[row] = configuration.row_rates_hz[row] ? NS_PER_SECOND / configuration.row_rates_hz[row] : 0;
+
+		last_read_ns[row] = 0;
+		boost_until_ns[row] = 0;
+		read_once[row] = false;
+	}
+}
+
+uint64_t ScanPolicy::effective_interval_ns(int row, uint64_t now_ns) const {
+	constexpr uint64_t BOOST_INTERVAL_NS = NS_PER_SECOND / SCAN_BOOST_RATE_HZ;
+
+	if(is_boosted(row, now_ns) && interval_ns[row] > BOOST_INTERVAL_NS) {
+		return BOOST_INTERVAL_NS;
+	}
+
+	return interval_ns[row];
+}
+
+int ScanPolicy::next_row(uint64_t now_ns) const {
+	int selected_row = -1;
+	uint64_t selected_interval_ns = 0;
+	uint64_t selected_overdue_ns = 0;
+
+	// Among the rows that are due, the slowest one goes first so the fast rows cannot starve it
+	for(int row = 0; row < 3; row++) {
+		if(!read_once[row]) {
+			return row;
+		}
+
+		uint64_t row_interval_ns = effective_interval_ns(row, now_ns);
+		uint64_t elapsed_ns = now_ns - last_read_ns[row];
+
+		if(elapsed_ns < row_interval_ns) {
+			continue;
+		}
+
+		uint64_t overdue_ns = elapsed_ns - row_interval_ns;
+
+		if(selected_row < 0 || row_interval_ns > selected_interval_ns ||
+			(row_interval_ns == selected_interval_ns && overdue_ns > selected_overdue_ns)) {
+			selected_row = row;
+			selected_interval_ns = row_interval_ns;
+			selected_overdue_ns = overdue_ns;
+		}
+	}
+
+	return selected_row;
+}
+
+void ScanPolicy::row_read(int row, uint16_t columns, uint64_t now_ns) {
+	if(read_once[row] && columns != last_columns[row]) {
+		boost_until_ns[row] = now_ns + SCAN_BOOST_HOLD_NS;
+	}
+
+	// Keep to the nominal rate even though reads can only happen at gap boundaries
+	uint64_t row_interval_ns = effective_interval_ns(row, now_ns);
+
+	if(read_once[row] && row_interval_ns != 0 && now_ns - last_read_ns[row] < 2 * row_interval_ns) {
+		last_read_ns[row] += row_interval_ns;
+	}
+	else {
+		last_read_ns[row] = now_ns;
+	}
+
+	last_columns[row] = columns;
+	read_once[row] = true;
+}
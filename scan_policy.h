@@ -0,0 +1,48 @@
+#ifndef SCAN_POLICY_H
+#define SCAN_POLICY_H
+
+#include <cstdint>
+
+// =============================================================
+// ScanPolicy: which switch row to read in each LED row gap
+// =============================================================
+
+struct ScanPolicyConfiguration {
+	// Reads per second for each switch row (0 reads the row in every gap no other row needs)
+	unsigned int row_rates_hz[3];
+};
+
+// Each row is read at its own rate, and for a while after a row changes it is read at least
+// at SCAN_BOOST_RATE_HZ, so the switch register can be refreshed slowly without making a
+// flipped switch feel sluggish. Gaps where no row is due do not touch the switch matrix.
+
+class ScanPolicy {
+private:
+	static constexpr unsigned int SCAN_BOOST_RATE_HZ = 200;
+	static constexpr uint64_t SCAN_BOOST_HOLD_NS = 1000000000;
+
+	uint64_t interval_ns[3];
+
+	uint64_t last_read_ns[3];
+	uint64_t boost_until_ns[3];
+
+	uint16_t last_columns[3];
+	bool read_once[3];
+
+	uint64_t effective_interval_ns(int row, uint64_t now_ns) const;
+
+public:
+	ScanPolicy();
+
+	void configure(const ScanPolicyConfiguration &configuration);
+
+	// Row to read in the next gap, or -1 when no row is due
+	int next_row(uint64_t now_ns) const;
+
+	// Called with every row that was read; a change boosts the row's rate
+	void row_read(int row, uint16_t columns, uint64_t now_ns);
+
+	bool is_boosted(int row, uint64_t now_ns) const { return now_ns < boost_until_ns[row]; }
+};
+
+#endif // SCAN_POLICY_H
@@ -0,0 +1,598 @@
+#include "scanner.h"
+#include "logger.h"
+#include "timing.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+using std::lock_guard;
+using std::mutex;
+
+// =============================================================
+// Timing constants
+// =============================================================
+
+constexpr unsigned int WAIT_SIGNAL_LED_BLANKING_NS    = 100000;
+constexpr unsigned int WAIT_SIGNAL_SWITCH_SETTLE_NS   = 50000;
+constexpr unsigned int WAIT_MODE_CHANGE_NS            = 10000;
+constexpr unsigned int WAIT_SWITCH_POLL_NS            = 1000000;
+
+// Reading one switch row: columns to inputs, settle, read, columns back to outputs
+constexpr unsigned int SWITCH_ROW_SCAN_NS             = WAIT_SIGNAL_SWITCH_SETTLE_NS + WAIT_MODE_CHANGE_NS + 30000;
+
+// Gap between LED rows: the row goes dark while one switch row is read
+constexpr unsigned int ROW_GAP_NS = (WAIT_SIGNAL_LED_BLANKING_NS > SWITCH_ROW_SCAN_NS) ? WAIT_SIGNAL_LED_BLANKING_NS : SWITCH_ROW_SCAN_NS;
+
+// Shortest time a row is kept on, whatever the frame rate
+constexpr unsigned int MINIMUM_ROW_ON_NS              = 50000;
+
+static_assert(NS_PER_SECOND / MAX_FRAME_RATE / 6 >= ROW_GAP_NS + MINIMUM_ROW_ON_NS, "row slots too short at the highest frame rate");
+
+// =============================================================
+// FrameStore
+// =============================================================
+
+FrameStore::FrameStore():
+	frames{},
+	middle{1},
+	back{0},
+	front{2} {
+}
+
+void FrameStore::publish(const LEDFrame &frame) {
+	frames[back] = frame;
+
+	back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+const LEDFrame& FrameStore::read() {
+	if(middle.load(std::memory_order_relaxed) & FRESH) {
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+	}
+
+	return frames[front];
+}
+
+// =============================================================
+// PanelScanner
+// =============================================================
+
+PanelScanner::PanelScanner(GPIOGroup *matrix, const ScannerConfiguration &configuration):
+	matrix{matrix},
+	configuration(configuration),
+	switch_sample{0},
+	switch_sample_time_ns{0},
+	switch_rows{},
+	row_read_time_ns{},
+	debounce_settle_ns{0},
+	reported_bounces{0},
+	event_rows{},
+	event_masks{},
+	event_rows_valid{false},
+	event_fd{-1},
+	statistics{},
+	frame_period_average_ns{0},
+	running{false},
+	initialized{false} {
+}
+
+PanelScanner::~PanelScanner() {
+	finish();
+}
+
+bool PanelScanner::init() {
+	if(initialized) {
+		return true;
+	}
+
+	if(!matrix || !matrix->is_initialized() || configuration.frame_rate == 0 || configuration.frame_rate > MAX_FRAME_RATE) {
+		return false;
+	}
+
+	event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if(event_fd < 0) {
+		logger->error("[SCANNER] Failed to create eventfd: %s\n", strerror(errno));
+		return false;
+	}
+
+	debouncer.configure(configuration.debounce);
+
+	debounce_settle_ns = 0;
+
+	for(const DebounceTimes &times : configuration.debounce.times) {
+		debounce_settle_ns = std::max<uint64_t>(debounce_settle_ns, std::max(times.press_us, times.release_us) * 1000ull);
+	}
+	scan_policy.configure(configuration.scan_policy);
+
+	// The encoder rotation is decoded here, only its steps are reported
+	for(int switch_row = 0; switch_row < 3; switch_row++) {
+		event_masks[switch_row] = COLS_MASK;
+	}
+
+	for(int encoder = 0; encoder < ENCODERS; encoder++) {
+		event_masks[ENCODER_SWITCH_ROW] &= ~((1u << configuration.encoders[encoder].col_a) | (1u << configuration.encoders[encoder].col_b));
+	}
+
+	for(int encoder = 0; encoder < ENCODERS; encoder++) {
+		encoders[encoder].set_acceleration(configuration.encoder_acceleration);
+	}
+
+	// Led pins off, switch rows off (high), column pins off (high)
+	if(!matrix->pins_set_mask(MATRIX_SWITCH_ROWS | MATRIX_COLS)) {
+		return false;
+	}
+
+	initialized = true;
+
+	return true;
+}
+
+void PanelScanner::finish() {
+	stop();
+
+	if(event_fd >= 0) {
+		close(event_fd);
+		event_fd = -1;
+	}
+
+	initialized = false;
+}
+
+bool PanelScanner::start() {
+	if(!initialized || running) {
+		return false;
+	}
+
+	running = true;
+	thread = std::thread(&PanelScanner::run, this);
+
+	return true;
+}
+
+void PanelScanner::stop() {
+	if(!running) {
+		return;
+	}
+
+	running = false;
+	thread.join();
+
+	// Leave the panel dark
+	matrix->pins_set_mask(MATRIX_SWITCH_ROWS | MATRIX_COLS);
+}
+
+void PanelScanner::setup_thread() {
+	if(configuration.cpu >= 0) {
+		cpu_set_t cpu_set;
+
+		CPU_ZERO(&cpu_set);
+		CPU_SET(configuration.cpu, &cpu_set);
+
+		int return_value = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+
+		if(return_value != 0) {
+			logger->error("[SCANNER] Failed to pin thread to CPU %d: %s\n", configuration.cpu, strerror(return_value));
+		}
+	}
+
+	if(configuration.realtime_priority > 0) {
+		struct sched_param parameters = {};
+
+		parameters.sched_priority = configuration.realtime_priority;
+
+		int return_value = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+
+		if(return_value != 0) {
+			logger->error("[SCANNER] Failed to set SCHED_FIFO priority %d: %s\n", configuration.realtime_priority, strerror(return_value));
+		}
+	}
+}
+
+void PanelScanner::run() {
+	setup_thread();
+
+	// The frames read one row at a time: the debouncer is seeded, and the first sample published,
+	// from a complete scan instead of rows that were not read yet
+	scan_switches(switch_rows);
+
+	uint64_t seed_time_ns = monotonic_time_ns();
+	uint16_t debounced[3];
+
+	debouncer.update(switch_rows, seed_time_ns, debounced);
+
+	// Events are generated against the seeded state from here on
+	queue_switch_events(debounced, publish_switches(debounced));
+
+	for(int switch_row = 0; switch_row < 3; switch_row++) {
+		row_read_time_ns[switch_row].store(seed_time_ns, std::memory_order_release);
+	}
+
+	uint64_t frame_period_ns = NS_PER_SECOND / configuration.frame_rate;
+	uint64_t deadline_ns = monotonic_time_ns();
+	uint64_t previous_start_ns = 0;
+
+	while(running) {
+		precision_timer->sleep_until_ns(deadline_ns);
+
+		uint64_t frame_start_ns = monotonic_time_ns();
+
+		record_frame(frame_start_ns - deadline_ns, previous_start_ns ? (int64_t) (frame_start_ns - previous_start_ns) : 0);
+		previous_start_ns = frame_start_ns;
+
+		scan_frame(frame_store.read(), deadline_ns, frame_period_ns);
+
+		deadline_ns += frame_period_ns;
+
+		// Fell behind by more than a frame: skip ahead instead of bursting to catch up
+		uint64_t now_ns = monotonic_time_ns();
+
+		if(now_ns > deadline_ns + frame_period_ns) {
+			lock_guard<mutex> guard(statistics_lock);
+
+			statistics.overruns++;
+			deadline_ns = now_ns;
+		}
+	}
+}
+
+// Lights the six LED rows in equal slots and reads at most one switch row in each gap between them,
+// as chosen by the scan policy
+void PanelScanner::scan_frame(const LEDFrame &frame, uint64_t frame_start_ns, uint64_t frame_period_ns) {
+	uint64_t row_slot_ns = frame_period_ns / 6;
+	uint64_t row_on_ns = (row_slot_ns > ROW_GAP_NS + MINIMUM_ROW_ON_NS) ? row_slot_ns - ROW_GAP_NS : MINIMUM_ROW_ON_NS;
+
+	// Share of the on-time for each bit plane, the last plane absorbs the rounding
+	uint64_t plane_on_ns[LED_BRIGHTNESS_BITS];
+	uint64_t assigned_ns = 0;
+
+	for(unsigned plane = 0; plane < LED_BRIGHTNESS_BITS; plane++) {
+		plane_on_ns[plane] = (plane + 1 < LED_BRIGHTNESS_BITS) ? row_on_ns * (1u << plane) / LED_BRIGHTNESS_MAX : row_on_ns - assigned_ns;
+		assigned_ns += plane_on_ns[plane];
+	}
+
+	uint64_t led_on_ns = 0;
+	uint64_t row_reads[3] = {0, 0, 0};
+	uint64_t idle_gaps = 0;
+	uint64_t gap_overruns = 0;
+
+	uint64_t row_start_ns = frame_start_ns;
+
+	for(int led_row = 0; led_row < 6; led_row++) {
+		uint32_t row_bit = 1u << (LED_ROWS_SHIFT + led_row);
+		uint64_t plane_end_ns = row_start_ns;
+		uint64_t row_lit_ns = 0;
+
+		for(unsigned plane = 0; plane < LED_BRIGHTNESS_BITS; plane++) {
+			uint16_t columns = frame.planes[plane][led_row];
+
+			// Set columns for this plane (lit LEDs are driven low), turning on the row with the first one;
+			// rows without intermediate brightness keep the same columns and need no further updates
+			if(plane == 0) {
+				matrix->pins_set_masked(MATRIX_LED_ROWS | MATRIX_COLS, row_bit | ((~columns & COLS_MASK) << COLS_SHIFT));
+				row_lit_ns = monotonic_time_ns();
+			}
+			else if(columns != frame.planes[plane - 1][led_row]) {
+				precision_timer->sleep_until_ns(plane_end_ns);
+				matrix->pins_set_masked(MATRIX_COLS, (~columns & COLS_MASK) << COLS_SHIFT);
+			}
+
+			plane_end_ns += plane_on_ns[plane];
+		}
+
+		// Keep it on for visibility
+		precision_timer->sleep_until_ns(row_start_ns + row_on_ns);
+
+		// Turn off this row and all columns
+		matrix->pins_set_masked(MATRIX_LED_ROWS | MATRIX_COLS, MATRIX_COLS);
+		led_on_ns += monotonic_time_ns() - row_lit_ns;
+
+		// Read the switch row the policy asks for (if any) while this one goes dark
+		uint64_t gap_start_ns = monotonic_time_ns();
+		int switch_row = scan_policy.next_row(gap_start_ns);
+
+		if(switch_row < 0) {
+			idle_gaps++;
+		}
+		else {
+			switch_rows[switch_row] = scan_switch_row(switch_row);
+			row_reads[switch_row]++;
+
+			uint64_t now_ns = monotonic_time_ns();
+
+			scan_policy.row_read(switch_row, switch_rows[switch_row], now_ns);
+
+			if(switch_row == ENCODER_SWITCH_ROW) {
+				bool detent = false;
+
+				for(int encoder = 0; encoder < ENCODERS; encoder++) {
+					detent |= encoders[encoder].update((switch_rows[switch_row] >> configuration.encoders[encoder].col_a) & 1,
+						(switch_rows[switch_row] >> configuration.encoders[encoder].col_b) & 1, now_ns);
+				}
+
+				if(detent) {
+					signal_panel_logic();
+				}
+			}
+
+			uint16_t debounced[3];
+
+			bool changed = debouncer.update(switch_rows, now_ns, debounced);
+			uint32_t sequence = publish_switches(debounced);
+
+			// After the sample that includes it
+			row_read_time_ns[switch_row].store(now_ns, std::memory_order_release);
+
+			if(changed) {
+				queue_switch_events(debounced, sequence);
+			}
+		}
+
+		row_start_ns += row_on_ns + ROW_GAP_NS;
+
+		if(monotonic_time_ns() > row_start_ns) {
+			gap_overruns++;
+		}
+
+		precision_timer->sleep_until_ns(row_start_ns);
+	}
+
+	lock_guard<mutex> guard(statistics_lock);
+
+	statistics.led_on_sum_ns += led_on_ns;
+	for(int switch_row = 0; switch_row < 3; switch_row++) {
+		statistics.row_reads[switch_row] += row_reads[switch_row];
+	}
+
+	statistics.idle_gaps += idle_gaps;
+	statistics.gap_overruns += gap_overruns;
+}
+
+void PanelScanner::begin_switch_scan() {
+	matrix->pin_mode_mask(MATRIX_COLS, PinMode::Input, PullMode::PullUp);
+}
+
+// Each row word has bit <col> set when the switch at (row, col) is closed
+uint16_t PanelScanner::read_switch_row(int switch_row) {
+	// Activate only this switch row (low)
+	matrix->pins_set_masked(MATRIX_SWITCH_ROWS, MATRIX_SWITCH_ROWS & ~(1u << (SWITCH_ROWS_SHIFT + switch_row)));
+
+	// Wait for signals to settle
+	precision_timer->delay_ns(WAIT_SIGNAL_SWITCH_SETTLE_NS);
+
+	// Read all columns
+	// Switch pressed: column reads low
+	uint32_t pin_values = MATRIX_COLS;
+
+	matrix->pins_get_mask(pin_values);
+
+	return (uint16_t) (~(pin_values >> COLS_SHIFT) & COLS_MASK);
+}
+
+void PanelScanner::end_switch_scan() {
+	// Deactivate all switch rows (high)
+	matrix->pins_set_masked(MATRIX_SWITCH_ROWS, MATRIX_SWITCH_ROWS);
+
+	// Avoids changing pin modes too quickly
+	precision_timer->delay_ns(WAIT_MODE_CHANGE_NS);
+
+	// Set all columns back to output mode (high)
+	matrix->pin_mode_mask(MATRIX_COLS, PinMode::Output);
+	matrix->pins_set_masked(MATRIX_COLS, MATRIX_COLS);
+}
+
+uint16_t PanelScanner::scan_switch_row(int switch_row) {
+	begin_switch_scan();
+	uint16_t columns = read_switch_row(switch_row);
+	end_switch_scan();
+
+	return columns;
+}
+
+void PanelScanner::scan_switches(uint16_t switches[3]) {
+	begin_switch_scan();
+
+	for(int switch_row = 0; switch_row < 3; switch_row++) {
+		switches[switch_row] = read_switch_row(switch_row);
+	}
+
+	end_switch_scan();
+}
+
+uint32_t PanelScanner::publish_switches(const uint16_t switches[3]) {
+	uint64_t sequence = (switch_sample.load(std::memory_order_relaxed) >> 36) + 1;
+
+	uint64_t sample = (uint64_t) (switches[0] & COLS_MASK) |
+		((uint64_t) (switches[1] & COLS_MASK) << 12) |
+		((uint64_t) (switches[2] & COLS_MASK) << 24) |
+		(sequence << 36);
+
+	switch_sample_time_ns.store(monotonic_time_ns(), std::memory_order_relaxed);
+	switch_sample.store(sample, std::memory_order_release);
+
+	// Same width as get_sequence()
+	return (uint32_t) (sequence & 0xFFFFFFF);
+}
+
+void PanelScanner::queue_switch_events(const uint16_t switches[3], uint32_t sequence) {
+	if(!event_rows_valid) {
+		for(int switch_row = 0; switch_row < 3; switch_row++) {
+			event_rows[switch_row] = switches[switch_row] & event_masks[switch_row];
+		}
+
+		event_rows_valid = true;
+		return;
+	}
+
+	bool queued = false;
+
+	for(int switch_row = 0; switch_row < 3; switch_row++) {
+		uint16_t columns = switches[switch_row] & event_masks[switch_row];
+
+		for(uint16_t bits = columns ^ event_rows[switch_row]; bits; bits &= bits - 1) {
+			int col = __builtin_ctz(bits);
+
+			SwitchEvent event;
+
+			event.timestamp_ns = debouncer.get_change_time_ns(switch_row, col);
+			event.sequence = sequence;
+			event.switch_id = (uint8_t) (switch_row * 12 + col);
+			event.level = (columns >> col) & 1;
+
+			queued |= switch_events.push(event);
+		}
+
+		event_rows[switch_row] = columns;
+	}
+
+	if(queued) {
+		signal_panel_logic();
+	}
+}
+
+void PanelScanner::signal_panel_logic() {
+	uint64_t increment = 1;
+
+	// Cannot fail short of counter overflow, and a pending signal is all that matters
+	ssize_t written = write(event_fd, &increment, sizeof(increment));
+	(void) written;
+}
+
+uint32_t PanelScanner::get_switches(uint16_t switches[3], uint64_t *sample_time_ns) const {
+	uint64_t sample = switch_sample.load(std::memory_order_acquire);
+
+	if(sample_time_ns) {
+		*sample_time_ns = switch_sample_time_ns.load(std::memory_order_relaxed);
+	}
+
+	switches[0] = sample & COLS_MASK;
+	switches[1] = (sample >> 12) & COLS_MASK;
+	switches[2] = (sample >> 24) & COLS_MASK;
+
+	return (uint32_t) (sample >> 36);
+}
+
+bool PanelScanner::wait_switches(uint16_t switches[3], unsigned int timeout_ms) {
+	// A change that happened just before the call is first seen by the next read of its row, and
+	// is accepted by a sample taken the debounce time after that
+	uint64_t call_ns = monotonic_time_ns();
+	uint64_t settled_ns = 0;
+
+	for(unsigned int waited_ms = 0; waited_ms <= timeout_ms; waited_ms++) {
+		uint64_t first_read_ns = 0;
+		uint64_t latest_read_ns = 0;
+
+		for(int switch_row = 0; switch_row < 3; switch_row++) {
+			uint64_t read_ns = row_read_time_ns[switch_row].load(std::memory_order_acquire);
+
+			first_read_ns = (switch_row == 0) ? read_ns : std::min(first_read_ns, read_ns);
+			latest_read_ns = std::max(latest_read_ns, read_ns);
+		}
+
+		// Once every row was read after the call, the latest of those reads is the last one to settle
+		if(settled_ns == 0 && first_read_ns >= call_ns) {
+			settled_ns = latest_read_ns + debounce_settle_ns;
+		}
+
+		if(settled_ns != 0 && latest_read_ns >= settled_ns) {
+			get_switches(switches);
+			return true;
+		}
+
+		precision_timer->sleep_ns(WAIT_SWITCH_POLL_NS);
+	}
+
+	return false;
+}
+
+void PanelScanner::record_frame(int64_t lateness_ns, int64_t period_ns) {
+	lock_guard<mutex> guard(statistics_lock);
+
+	statistics.frames++;
+
+	statistics.lateness_sum_ns += lateness_ns;
+
+	if(lateness_ns > statistics.lateness_max_ns) {
+		statistics.lateness_max_ns = lateness_ns;
+	}
+
+	if(period_ns > 0) {
+		uint64_t average_ns = frame_period_average_ns.load(std::memory_order_relaxed);
+
+		// Weight 1/16 for the new period
+		average_ns = average_ns ? (average_ns * 15 + period_ns) / 16 : period_ns;
+		frame_period_average_ns.store(average_ns, std::memory_order_relaxed);
+
+		statistics.period_sum_ns += period_ns;
+
+		if(statistics.period_min_ns == 0 || period_ns < statistics.period_min_ns) {
+			statistics.period_min_ns = period_ns;
+		}
+
+		if(period_ns > statistics.period_max_ns) {
+			statistics.period_max_ns = period_ns;
+		}
+	}
+}
+
+void PanelScanner::report_statistics(bool reset) {
+	FrameStatistics snapshot;
+
+	{
+		lock_guard<mutex> guard(statistics_lock);
+
+		snapshot = statistics;
+
+		if(reset) {
+			statistics = FrameStatistics{};
+		}
+	}
+
+	if(snapshot.frames < 2) {
+		logger->info("[SCANNER] No frames recorded\n");
+		return;
+	}
+
+	double period_average_ns = (double) snapshot.period_sum_ns / (snapshot.frames - 1);
+	double lateness_average_ns = (double) snapshot.lateness_sum_ns / snapshot.frames;
+
+	logger->info("[SCANNER] %llu frames, target %u Hz, measured %.1f Hz\n",
+		(unsigned long long) snapshot.frames, configuration.frame_rate, NS_PER_SECOND / period_average_ns);
+	logger->info("[SCANNER] Frame period min/avg/max: %.3f/%.3f/%.3f ms (jitter %.3f ms)\n",
+		snapshot.period_min_ns / 1e6, period_average_ns / 1e6, snapshot.period_max_ns / 1e6,
+		(snapshot.period_max_ns - snapshot.period_min_ns) / 1e6);
+	logger->info("[SCANNER] Deadline lateness avg/max: %.1f/%.1f us, overruns: %llu\n",
+		lateness_average_ns / 1e3, snapshot.lateness_max_ns / 1e3, (unsigned long long) snapshot.overruns);
+	logger->info("[SCANNER] LED rows lit %.1f%% of the frame, row gaps overrun: %llu\n",
+		100.0 * snapshot.led_on_sum_ns / (snapshot.frames * period_average_ns), (unsigned long long) snapshot.gap_overruns);
+
+	double elapsed_s = snapshot.frames * period_average_ns / NS_PER_SECOND;
+	uint64_t bounces = debouncer.get_bounces();
+
+	logger->info("[SCANNER] Switch rows sampled at %.1f/%.1f/%.1f Hz, %.1f%% of gaps idle, bounces rejected: %llu\n",
+		snapshot.row_reads[0] / elapsed_s, snapshot.row_reads[1] / elapsed_s, snapshot.row_reads[2] / elapsed_s,
+		100.0 * snapshot.idle_gaps / (snapshot.frames * 6), (unsigned long long) (bounces - reported_bounces));
+
+	if(reset) {
+		reported_bounces = bounces;
+	}
+
+	logger->info("[SCANNER] Switch events dropped (queue full, since start): %llu\n", (unsigned long long) switch_events.get_dropped());
+
+	uint64_t fallbacks = matrix->get_reconfigure_fallbacks();
+
+	if(fallbacks) {
+		logger->error("[SCANNER] GPIO reconfigurations in place that fell back to re-requesting (since start): %llu\n", (unsigned long long) fallbacks);
+	}
+
+	for(int encoder = 0; encoder < ENCODERS; encoder++) {
+		logger->info("[SCANNER] Encoder %d: %llu detents, %llu illegal transitions (since start)\n", encoder + 1,
+			(unsigned long long) encoders[encoder].get_detents(), (unsigned long long) encoders[encoder].get_illegal_transitions());
+	}
+}
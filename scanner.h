@@ -0,0 +1,263 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include "gpio.h"
+#include "debounce.h"
+#include "encoder.h"
+#include "scan_policy.h"
+#include "switch_events.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+
+// =============================================================
+// Matrix layout
+// =============================================================
+
+// All 21 pins are held in a single GPIOGroup, in the order
+// LED rows (bits 0-5), switch rows (bits 6-8), columns (bits 9-20)
+constexpr unsigned LED_ROWS_SHIFT    = 0;
+constexpr unsigned SWITCH_ROWS_SHIFT = 6;
+constexpr unsigned COLS_SHIFT        = 9;
+
+constexpr uint32_t COLS_MASK         = 0xFFF;
+
+constexpr uint32_t MATRIX_LED_ROWS    = 0x3Fu << LED_ROWS_SHIFT;
+constexpr uint32_t MATRIX_SWITCH_ROWS = 0x7u << SWITCH_ROWS_SHIFT;
+constexpr uint32_t MATRIX_COLS        = COLS_MASK << COLS_SHIFT;
+
+// =============================================================
+// LED frames
+// =============================================================
+
+// Brightness is encoded in bit planes (bit-angle modulation): while a row is on,
+// plane <b> drives the columns for a share of the on-time proportional to 2^b
+constexpr unsigned LED_BRIGHTNESS_BITS = 3;
+constexpr unsigned LED_BRIGHTNESS_MAX  = (1u << LED_BRIGHTNESS_BITS) - 1;
+
+// Each row word has bit <col> set when the LED at (row, col) is lit in that plane
+struct LEDFrame {
+	uint16_t planes[LED_BRIGHTNESS_BITS][6];
+
+	// Lights the LEDs set in the row word at full brightness, the others are off
+	void set_row(int row, uint16_t bits) {
+		for(unsigned plane = 0; plane < LED_BRIGHTNESS_BITS; plane++) {
+			planes[plane][row] = bits;
+		}
+	}
+
+	// Level goes from 0 (off) to LED_BRIGHTNESS_MAX (full brightness)
+	void set_level(int row, int col, unsigned level) {
+		for(unsigned plane = 0; plane < LED_BRIGHTNESS_BITS; plane++) {
+			if(level & (1u << plane)) {
+				planes[plane][row] |= (1u << col);
+			}
+			else {
+				planes[plane][row] &= ~(1u << col);
+			}
+		}
+	}
+};
+
+// Lock-free triple buffer between one producer (panel logic) and one consumer (scanner):
+// the producer fills the back frame and swaps it with the middle one, the consumer swaps
+// the middle frame with its front one only when a newer frame was published
+class FrameStore {
+private:
+	static constexpr unsigned int FRESH = 4;
+
+	LEDFrame frames[3];
+
+	// Index of the middle frame, with FRESH set until the consumer picks it up
+	std::atomic<unsigned int> middle;
+
+	// Owned by the producer and the consumer, respectively
+	unsigned int back;
+	unsigned int front;
+
+public:
+	FrameStore();
+
+	void publish(const LEDFrame &frame);
+
+	// The returned frame stays valid until the next call
+	const LEDFrame& read();
+};
+
+// =============================================================
+// PanelScanner: LED refresh and switch scanning thread
+// =============================================================
+
+// Rotary encoders sit on switch row 2
+constexpr int ENCODER_SWITCH_ROW = 2;
+constexpr int ENCODERS = 2;
+
+struct EncoderPins {
+	int col_a;
+	int col_b;
+};
+
+// Highest frame rate whose row slots still hold the minimum on-time and a switch row read
+constexpr unsigned int MAX_FRAME_RATE = 1000;
+
+struct ScannerConfiguration {
+	// Target LED frames per second (1 to MAX_FRAME_RATE)
+	unsigned int frame_rate;
+
+	// SCHED_FIFO priority for the scanner thread (0 keeps the default scheduler)
+	int realtime_priority;
+
+	// CPU the scanner thread is pinned to (-1 for no affinity)
+	int cpu;
+
+	// Applied to every complete switch scan before it is published
+	DebounceConfiguration debounce;
+
+	EncoderPins encoders[ENCODERS];
+	bool encoder_acceleration;
+
+	ScanPolicyConfiguration scan_policy;
+};
+
+struct FrameStatistics {
+	uint64_t frames;
+
+	// Time between consecutive frame starts
+	int64_t period_min_ns;
+	int64_t period_max_ns;
+	int64_t period_sum_ns;
+
+	// How late each frame started with respect to its deadline
+	int64_t lateness_max_ns;
+	int64_t lateness_sum_ns;
+
+	// Frames whose deadline had already passed when the previous one finished
+	uint64_t overruns;
+
+	// Time LED rows were actually lit, summed over rows
+	uint64_t led_on_sum_ns;
+
+	// Switch row reads in the gaps between LED rows, and gaps without one
+	uint64_t row_reads[3];
+	uint64_t idle_gaps;
+
+	// Gaps where the switch row read ran past the start of the next LED row
+	uint64_t gap_overruns;
+};
+
+class PanelScanner {
+private:
+	GPIOGroup *matrix;
+	ScannerConfiguration configuration;
+
+	FrameStore frame_store;
+
+	// Rows 0-2 in bits 0-35, scan sequence number above them
+	std::atomic<uint64_t> switch_sample;
+
+	// CLOCK_MONOTONIC time the latest sample was completed
+	std::atomic<uint64_t> switch_sample_time_ns;
+
+	// Latest reading of each switch row (owned by the thread)
+	uint16_t switch_rows[3];
+
+	// When each row was last read, stored once the sample that includes the reading is published
+	std::atomic<uint64_t> row_read_time_ns[3];
+
+	// Longest press or release time of the debouncer
+	uint64_t debounce_settle_ns;
+
+	ScanPolicy scan_policy;
+
+	QuadratureDecoder encoders[ENCODERS];
+
+	SwitchDebouncer debouncer;
+	uint64_t reported_bounces;
+
+	SwitchEventQueue switch_events;
+
+	// Debounced state the last events were generated against (encoder rotation pins excluded)
+	uint16_t event_rows[3];
+	uint16_t event_masks[3];
+	bool event_rows_valid;
+
+	// Signaled when there are switch events or encoder steps for the panel logic
+	int event_fd;
+
+	FrameStatistics statistics;
+	std::mutex statistics_lock;
+
+	// Moving average of the measured frame period (not reset with the statistics)
+	std::atomic<uint64_t> frame_period_average_ns;
+
+	std::thread thread;
+	std::atomic<bool> running;
+
+	bool initialized;
+
+	void run();
+	void setup_thread();
+
+	void scan_frame(const LEDFrame &frame, uint64_t frame_start_ns, uint64_t frame_period_ns);
+
+	// Columns are inputs between begin_switch_scan() and end_switch_scan()
+	void begin_switch_scan();
+	uint16_t read_switch_row(int switch_row);
+	void end_switch_scan();
+
+	uint16_t scan_switch_row(int switch_row);
+
+	uint32_t publish_switches(const uint16_t switches[3]);
+	void queue_switch_events(const uint16_t switches[3], uint32_t sequence);
+
+	void signal_panel_logic();
+
+	void record_frame(int64_t lateness_ns, int64_t period_ns);
+
+public:
+	PanelScanner(GPIOGroup *matrix, const ScannerConfiguration &configuration);
+	~PanelScanner();
+
+	bool init();
+	void finish();
+
+	bool start();
+	void stop();
+
+	// Scans the switch matrix directly (only while the thread is stopped)
+	void scan_switches(uint16_t switches[3]);
+
+	// Called by the panel logic
+	void publish_frame(const LEDFrame &frame) { frame_store.publish(frame); }
+
+	// Returns the scan sequence number of the latest sample (and optionally when it was taken)
+	uint32_t get_switches(uint16_t switches[3], uint64_t *sample_time_ns = nullptr) const;
+
+	uint32_t get_sequence() const { return (uint32_t) (switch_sample.load(std::memory_order_acquire) >> 36); }
+
+	// Debounced switch changes, in order, tagged with the sequence number of the sample that includes them
+	bool pop_switch_event(SwitchEvent &event) { return switch_events.pop(event); }
+	uint64_t get_dropped_switch_events() const { return switch_events.get_dropped(); }
+
+	// Readable (eventfd) when switch events or encoder steps are pending
+	int get_event_fd() const { return event_fd; }
+
+	// Encoder steps since the previous call (positive is clockwise)
+	int32_t take_encoder_steps(int encoder) { return encoders[encoder].take_steps(); }
+
+	// Waits until every row was read after the call and the debounce times have passed,
+	// so a switch that was already set when called is reported as it is
+	bool wait_switches(uint16_t switches[3], unsigned int timeout_ms);
+
+	void report_statistics(bool reset);
+
+	// Measured, 0 before the first frames
+	uint64_t get_frame_period_ns() const { return frame_period_average_ns.load(std::memory_order_relaxed); }
+
+	bool is_running() const { return running; }
+	bool is_initialized() const { return initialized; }
+};
+
+#endif // SCANNER_H
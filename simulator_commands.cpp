@@ -0,0 +1,285 @@
+#include "simulator_commands.h"
+#include "logger.h"
+#include "timing.h"
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+SimulatorCommandQueue::SimulatorCommandQueue():
+	panel{nullptr},
+	display_callback{nullptr},
+	display_context{nullptr},
+	completion_fd{-1},
+	next_id{1},
+	in_flight{0},
+	executed{0},
+	failed{0},
+	execution_sum_ns{0},
+	execution_max_ns{0},
+	turnaround_sum_ns{0},
+	turnaround_max_ns{0},
+	depth_max{0},
+	running{false},
+	initialized{false} {
+}
+
+SimulatorCommandQueue::~SimulatorCommandQueue() {
+	finish();
+}
+
+bool SimulatorCommandQueue::init(PANEL *panel) {
+	if(initialized) {
+		return true;
+	}
+
+	if(!panel) {
+		return false;
+	}
+
+	completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if(completion_fd < 0) {
+		logger->error("[COMMANDS] Failed to create eventfd: %s\n", strerror(errno));
+		return false;
+	}
+
+	this->panel = panel;
+
+	running = true;
+	thread = std::thread(&SimulatorCommandQueue::run, this);
+
+	initialized = true;
+
+	return true;
+}
+
+void SimulatorCommandQueue::finish() {
+	if(!initialized) {
+		return;
+	}
+
+	{
+		lock_guard<mutex> guard(lock);
+
+		running = false;
+	}
+
+	pending_ready.notify_one();
+
+	// The command in execution (if any) completes, the ones behind it are dropped
+	if(thread.joinable()) {
+		thread.join();
+	}
+
+	if(!pending.empty()) {
+		logger->info("[COMMANDS] Dropped %zu pending commands\n", pending.size());
+	}
+
+	pending.clear();
+	completed.clear();
+	in_flight = 0;
+
+	close(completion_fd);
+	completion_fd = -1;
+
+	panel = nullptr;
+
+	initialized = false;
+}
+
+// =============================================================
+// Submission and completion (panel logic)
+// =============================================================
+
+uint64_t SimulatorCommandQueue::submit(SimulatorCommand command) {
+	uint64_t id;
+
+	{
+		lock_guard<mutex> guard(lock);
+
+		id = next_id++;
+
+		command.id = id;
+		command.submit_time_ns = monotonic_time_ns();
+		command.complete_time_ns = 0;
+		command.status = -1;
+
+		pending.push_back(std::move(command));
+		in_flight++;
+
+		if(pending.size() > depth_max) {
+			depth_max = pending.size();
+		}
+	}
+
+	pending_ready.notify_one();
+
+	return id;
+}
+
+uint64_t SimulatorCommandQueue::submit(SimulatorCommandType type, uint64_t tag) {
+	SimulatorCommand command = {};
+
+	command.type = type;
+	command.tag = tag;
+
+	return submit(std::move(command));
+}
+
+bool SimulatorCommandQueue::pop_completion(SimulatorCommand &command) {
+	lock_guard<mutex> guard(lock);
+
+	if(completed.empty()) {
+		return false;
+	}
+
+	command = std::move(completed.front());
+	completed.pop_front();
+	in_flight--;
+
+	return true;
+}
+
+unsigned SimulatorCommandQueue::get_in_flight() {
+	lock_guard<mutex> guard(lock);
+
+	return in_flight;
+}
+
+// =============================================================
+// Worker thread
+// =============================================================
+
+void SimulatorCommandQueue::run() {
+	unique_lock<mutex> guard(lock);
+
+	while(true) {
+		pending_ready.wait(guard, [this] { return !running || !pending.empty(); });
+
+		if(!running) {
+			break;
+		}
+
+		SimulatorCommand command = std::move(pending.front());
+		pending.pop_front();
+
+		// The panel logic can submit more commands while this one executes
+		guard.unlock();
+
+		uint64_t start_ns = monotonic_time_ns();
+		command.status = execute(command);
+		command.complete_time_ns = monotonic_time_ns();
+
+		if(command.status != 0) {
+			logger->error("[COMMANDS] Command %llu failed: %s\n", (unsigned long long) command.id, sim_panel_get_error());
+			sim_panel_clear_error();
+		}
+
+		guard.lock();
+
+		uint64_t execution_ns = command.complete_time_ns - start_ns;
+		uint64_t turnaround_ns = command.complete_time_ns - command.submit_time_ns;
+
+		executed++;
+		failed += (command.status != 0);
+		execution_sum_ns += execution_ns;
+		execution_max_ns = std::max(execution_max_ns, execution_ns);
+		turnaround_sum_ns += turnaround_ns;
+		turnaround_max_ns = std::max(turnaround_max_ns, turnaround_ns);
+
+		completed.push_back(std::move(command));
+
+		uint64_t increment = 1;
+
+		ssize_t written = write(completion_fd, &increment, sizeof(increment));
+		(void) written;
+	}
+}
+
+int SimulatorCommandQueue::execute(SimulatorCommand &command) {
+	switch(command.type) {
+		case SimulatorCommandType::Boot:
+			return sim_panel_exec_boot(panel, command.name.c_str());
+
+		case SimulatorCommandType::Halt:
+			return sim_panel_exec_halt(panel);
+
+		case SimulatorCommandType::Run:
+			return sim_panel_exec_run(panel);
+
+		case SimulatorCommandType::Step:
+			return sim_panel_exec_step(panel);
+
+		case SimulatorCommandType::Examine:
+			return sim_panel_mem_examine(panel, sizeof(command.address), &command.address, sizeof(command.value), &command.value);
+
+		case SimulatorCommandType::Deposit:
+			return sim_panel_mem_deposit(panel, sizeof(command.address), &command.address, sizeof(command.value), &command.value);
+
+		case SimulatorCommandType::SetRegister:
+			return sim_panel_set_register_value(panel, command.name.c_str(), command.text.c_str());
+
+		case SimulatorCommandType::AddRegister:
+			return sim_panel_add_register(panel, command.name.c_str(), nullptr, command.size, command.storage);
+
+		case SimulatorCommandType::SetCallbackInterval:
+			return sim_panel_set_display_callback_interval(panel, display_callback, display_context, command.interval_us);
+
+		case SimulatorCommandType::SetSamplingParameters:
+			return sim_panel_set_sampling_parameters(panel, command.sample_frequency, command.sample_depth);
+	}
+
+	return -1;
+}
+
+// =============================================================
+// Statistics
+// =============================================================
+
+void SimulatorCommandQueue::report_statistics(bool reset) {
+	uint64_t executed_snapshot, failed_snapshot;
+	uint64_t execution_sum_snapshot, execution_max_snapshot;
+	uint64_t turnaround_sum_snapshot, turnaround_max_snapshot;
+	unsigned depth_max_snapshot;
+
+	{
+		lock_guard<mutex> guard(lock);
+
+		executed_snapshot = executed;
+		failed_snapshot = failed;
+		execution_sum_snapshot = execution_sum_ns;
+		execution_max_snapshot = execution_max_ns;
+		turnaround_sum_snapshot = turnaround_sum_ns;
+		turnaround_max_snapshot = turnaround_max_ns;
+		depth_max_snapshot = depth_max;
+
+		if(reset) {
+			executed = 0;
+			failed = 0;
+			execution_sum_ns = 0;
+			execution_max_ns = 0;
+			turnaround_sum_ns = 0;
+			turnaround_max_ns = 0;
+			depth_max = 0;
+		}
+	}
+
+	if(executed_snapshot == 0) {
+		logger->info("[COMMANDS] No simulator commands\n");
+		return;
+	}
+
+	logger->info("[COMMANDS] %llu simulator commands (%llu failed), deepest queue %u\n",
+		(unsigned long long) executed_snapshot, (unsigned long long) failed_snapshot, depth_max_snapshot);
+	logger->info("[COMMANDS] Execution avg/max: %.2f/%.2f ms, submit to completion avg/max: %.2f/%.2f ms\n",
+		execution_sum_snapshot / 1e6 / executed_snapshot, execution_max_snapshot / 1e6,
+		turnaround_sum_snapshot / 1e6 / executed_snapshot, turnaround_max_snapshot / 1e6);
+}
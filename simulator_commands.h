@@ -0,0 +1,137 @@
+#ifndef SIMULATOR_COMMANDS_H
+#define SIMULATOR_COMMANDS_H
+
+extern "C" {
+	#include "sim_frontpanel.h"
+}
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+// =============================================================
+// Simulator commands
+// =============================================================
+
+enum class SimulatorCommandType {
+	Boot,
+	Halt,
+	Run,
+	Step,
+	Examine,
+	Deposit,
+	SetRegister,
+	AddRegister,
+	SetCallbackInterval,
+	SetSamplingParameters
+};
+
+struct SimulatorCommand {
+	SimulatorCommandType type;
+
+	// Memory address (Examine, Deposit)
+	uint32_t address;
+
+	// Value to deposit, or the examined value on completion
+	uint16_t value;
+
+	// Boot device (Boot), register name and value (SetRegister), register name (AddRegister)
+	std::string name;
+	std::string text;
+
+	// Register storage (AddRegister)
+	void *storage;
+	size_t size;
+
+	// Display callback interval (SetCallbackInterval)
+	int interval_us;
+
+	// Instructions between samples and samples kept per bit (SetSamplingParameters)
+	unsigned int sample_frequency;
+	unsigned int sample_depth;
+
+	// Set by the caller, handed back untouched (e.g. the switch event timestamp)
+	uint64_t tag;
+
+	// Filled in by the queue
+	uint64_t id;
+	uint64_t submit_time_ns;
+	uint64_t complete_time_ns;
+
+	// Return value of the sim_frontpanel call (0 on success)
+	int status;
+};
+
+// A worker thread owns the command channel of the PANEL: the panel logic submits
+// commands and keeps refreshing while they run; commands submitted back to back are
+// executed one after the other, in order, without waiting for the panel logic in between
+// Each command is still one blocking round trip to the simulator: nothing is pipelined
+// Completed commands are collected with pop_completion(), an eventfd signals them
+
+class SimulatorCommandQueue {
+private:
+	PANEL *panel;
+
+	PANEL_DISPLAY_PCALLBACK display_callback;
+	void *display_context;
+
+	std::deque<SimulatorCommand> pending;
+	std::deque<SimulatorCommand> completed;
+
+	std::mutex lock;
+	std::condition_variable pending_ready;
+
+	int completion_fd;
+
+	uint64_t next_id;
+	unsigned in_flight;
+
+	// Statistics (under the lock)
+	uint64_t executed;
+	uint64_t failed;
+	uint64_t execution_sum_ns;
+	uint64_t execution_max_ns;
+	uint64_t turnaround_sum_ns;
+	uint64_t turnaround_max_ns;
+	unsigned depth_max;
+
+	std::thread thread;
+	bool running;
+	bool initialized;
+
+	void run();
+
+	int execute(SimulatorCommand &command);
+
+public:
+	SimulatorCommandQueue();
+	~SimulatorCommandQueue();
+
+	bool init(PANEL *panel);
+	void finish();
+
+	// Used by SetCallbackInterval commands
+	void set_display_callback(PANEL_DISPLAY_PCALLBACK callback, void *context) { display_callback = callback; display_context = context; }
+
+	// Returns the id of the command
+	uint64_t submit(SimulatorCommand command);
+
+	uint64_t submit(SimulatorCommandType type, uint64_t tag = 0);
+
+	bool pop_completion(SimulatorCommand &command);
+
+	// Commands submitted and not yet popped as completions
+	unsigned get_in_flight();
+
+	// Readable (eventfd) when completions are pending
+	int get_completion_fd() const { return completion_fd; }
+
+	void report_statistics(bool reset);
+
+	bool is_initialized() const { return initialized; }
+};
+
+#endif // SIMULATOR_COMMANDS_H
@@ -0,0 +1,239 @@
+#include "simulator_process.h"
+#include "logger.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <unistd.h>
+
+SimulatorProcess::SimulatorProcess():
+	pid{0},
+	report_time_ns{0},
+	report_cpu_ns{0} {
+}
+
+vector<pid_t> SimulatorProcess::list_children() {
+	vector<pid_t> children;
+
+	DIR *directory = opendir("/proc");
+
+	if(!directory) {
+		return children;
+	}
+
+	pid_t self = getpid();
+
+	while(struct dirent *entry = readdir(directory)) {
+		char *end;
+		long process = strtol(entry->d_name, &end, 10);
+
+		if(*end != '\0' || process <= 0) {
+			continue;
+		}
+
+		char path[64];
+		snprintf(path, sizeof(path), "/proc/%ld/stat", process);
+
+		FILE *file = fopen(path, "r");
+
+		if(!file) {
+			continue;
+		}
+
+		char line[512];
+		bool read = fgets(line, sizeof(line), file) != nullptr;
+
+		fclose(file);
+
+		// <pid> (<comm>) <state> <ppid> ..., the command may contain spaces and parentheses
+		char *fields = read ? strrchr(line, ')') : nullptr;
+		char state;
+		int parent;
+
+		if(fields && sscanf(fields + 1, " %c %d", &state, &parent) == 2 && parent == self) {
+			children.push_back((pid_t) process);
+		}
+	}
+
+	closedir(directory);
+
+	return children;
+}
+
+bool SimulatorProcess::find(const vector<pid_t> &children_before) {
+	for(pid_t child : list_children()) {
+		if(std::find(children_before.begin(), children_before.end(), child) == children_before.end()) {
+			pid = child;
+
+			report_time_ns = monotonic_time_ns();
+			report_cpu_ns = 0;
+			read_cpu_time(report_cpu_ns);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool SimulatorProcess::read_cpu_time(uint64_t &cpu_ns) const {
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+
+	FILE *file = fopen(path, "r");
+
+	if(!file) {
+		return false;
+	}
+
+	char line[1024];
+	bool read = fgets(line, sizeof(line), file) != nullptr;
+
+	fclose(file);
+
+	// utime and stime are the 12th and 13th fields after the command
+	char *fields = read ? strrchr(line, ')') : nullptr;
+	unsigned long long user_ticks, system_ticks;
+
+	if(!fields || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &user_ticks, &system_ticks) != 2) {
+		return false;
+	}
+
+	cpu_ns = (user_ticks + system_ticks) * (NS_PER_SECOND / sysconf(_SC_CLK_TCK));
+
+	return true;
+}
+
+// Threads started later inherit the affinity of the thread that creates them
+bool SimulatorProcess::set_affinity(const cpu_set_t &cpus) {
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/task", (int) pid);
+
+	DIR *directory = opendir(path);
+
+	if(!directory) {
+		logger->error("[INSTANCES] Cannot list the threads of simulator process %d\n", (int) pid);
+		return false;
+	}
+
+	bool success = true;
+
+	while(struct dirent *entry = readdir(directory)) {
+		pid_t thread = (pid_t) atoi(entry->d_name);
+
+		if(thread > 0 && sched_setaffinity(thread, sizeof(cpus), &cpus) != 0) {
+			logger->error("[INSTANCES] Failed to set the CPU affinity of simulator thread %d: %s\n", (int) thread, strerror(errno));
+			success = false;
+		}
+	}
+
+	closedir(directory);
+
+	return success;
+}
+
+void SimulatorProcess::report_statistics(const string &name, bool reset) {
+	uint64_t now_ns = monotonic_time_ns();
+	uint64_t cpu_ns;
+	cpu_set_t cpus;
+
+	if(pid <= 0 || !read_cpu_time(cpu_ns) || sched_getaffinity(pid, sizeof(cpus), &cpus) != 0) {
+		logger->info("[INSTANCES] %s: simulator process unknown\n", name.c_str());
+		return;
+	}
+
+	double elapsed_s = (now_ns - report_time_ns) / (double) NS_PER_SECOND;
+	double cpu_s = (cpu_ns - report_cpu_ns) / (double) NS_PER_SECOND;
+
+	// CPU time comes in clock ticks, too coarse for a percentage of short periods
+	if(elapsed_s < 1) {
+		logger->info("[INSTANCES] %s (pid %d): %.2f s of CPU time in %.2f s, CPUs %s\n",
+			name.c_str(), (int) pid, cpu_s, elapsed_s, format_cpu_list(cpus).c_str());
+	}
+	else {
+		logger->info("[INSTANCES] %s (pid %d): %.1f%% of one core over %.1f s, CPUs %s\n",
+			name.c_str(), (int) pid, 100.0 * cpu_s / elapsed_s, elapsed_s, format_cpu_list(cpus).c_str());
+	}
+
+	if(reset) {
+		report_time_ns = now_ns;
+		report_cpu_ns = cpu_ns;
+	}
+}
+
+int get_cpu_limit() {
+	long configured = sysconf(_SC_NPROCESSORS_CONF);
+
+	return (configured > 0 && configured < CPU_SETSIZE) ? (int) configured : CPU_SETSIZE;
+}
+
+// <cpu>[-<cpu>][,...]
+bool parse_cpu_list(const char *option, cpu_set_t &cpus) {
+	CPU_ZERO(&cpus);
+
+	const char *position = option;
+
+	while(*position) {
+		char *end;
+		long first = strtol(position, &end, 10);
+		long last = first;
+
+		if(end == position || first < 0) {
+			return false;
+		}
+
+		if(*end == '-') {
+			position = end + 1;
+			last = strtol(position, &end, 10);
+
+			if(end == position || last < first) {
+				return false;
+			}
+		}
+
+		if(last >= get_cpu_limit()) {
+			return false;
+		}
+
+		for(long cpu = first; cpu <= last; cpu++) {
+			CPU_SET(cpu, &cpus);
+		}
+
+		if(*end == ',') {
+			end++;
+		}
+		else if(*end != '\0') {
+			return false;
+		}
+
+		position = end;
+	}
+
+	return CPU_COUNT(&cpus) > 0;
+}
+
+string format_cpu_list(const cpu_set_t &cpus) {
+	string list;
+
+	for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if(!CPU_ISSET(cpu, &cpus)) {
+			continue;
+		}
+
+		int last = cpu;
+
+		while(last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpus)) {
+			last++;
+		}
+
+		list += (list.empty() ? "" : ",") + std::to_string(cpu) + (last > cpu ? "-" + std::to_string(last) : "");
+		cpu = last;
+	}
+
+	return list;
+}
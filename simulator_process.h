@@ -0,0 +1,55 @@
+#ifndef SIMULATOR_PROCESS_H
+#define SIMULATOR_PROCESS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <sched.h>
+#include <sys/types.h>
+
+using std::string;
+using std::vector;
+
+// =============================================================
+// Simulator process
+// =============================================================
+
+// The process of a simulator started by sim_frontpanel, which does not tell its pid:
+// it is found as the child process that appeared while the simulator was started
+// CPU time is read from /proc/<pid>/stat, affinity is set for all its threads
+
+class SimulatorProcess {
+private:
+	pid_t pid;
+
+	// CPU time since the last report
+	uint64_t report_time_ns;
+	uint64_t report_cpu_ns;
+
+	bool read_cpu_time(uint64_t &cpu_ns) const;
+
+public:
+	SimulatorProcess();
+
+	static vector<pid_t> list_children();
+
+	// Finds the child that is not in <children_before>
+	bool find(const vector<pid_t> &children_before);
+
+	bool set_affinity(const cpu_set_t &cpus);
+
+	void report_statistics(const string &name, bool reset);
+
+	pid_t get_pid() const { return pid; }
+};
+
+// CPUs 0 to the returned count - 1 can be named (configured CPUs, within CPU_SETSIZE)
+int get_cpu_limit();
+
+// <cpu>[-<cpu>][,...]
+bool parse_cpu_list(const char *option, cpu_set_t &cpus);
+
+string format_cpu_list(const cpu_set_t &cpus);
+
+#endif // SIMULATOR_PROCESS_H
@@ -0,0 +1,401 @@
+#include "snapshot.h"
+#include "logger.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::ifstream;
+using std::stringstream;
+
+SnapshotStore::SnapshotStore(const string &directory, unsigned int remote_console_port):
+	directory{directory},
+	remote_console_port{remote_console_port},
+	boots{0},
+	boot_sum_ns{0},
+	restores{0},
+	restore_sum_ns{0},
+	restore_skipped_sum_s{0},
+	initialized{false} {
+}
+
+bool SnapshotStore::init() {
+	if(initialized) {
+		return true;
+	}
+
+	if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+		logger->error("[SNAPSHOT] Cannot create snapshot directory %s: %s\n", directory.c_str(), strerror(errno));
+		return false;
+	}
+
+	initialized = true;
+
+	return true;
+}
+
+// <directory>/<switch code>, with .sav (snapshot), .state (what it depends on) and .ini (restore configuration)
+string SnapshotStore::get_base_path(const ConfigurationEntry &entry) const {
+	char name[16];
+	snprintf(name, sizeof(name), "%06o", entry.switch_code);
+
+	return directory + "/" + name;
+}
+
+void SnapshotStore::read_file_state(const string &path, TrackedFile &file) {
+	struct stat status;
+
+	file.path = path;
+
+	if(stat(path.c_str(), &status) != 0) {
+		file.size = -1;
+		file.mtime_ns = 0;
+		return;
+	}
+
+	file.size = status.st_size;
+	file.mtime_ns = (int64_t) status.st_mtim.tv_sec * NS_PER_SECOND + status.st_mtim.tv_nsec;
+}
+
+// The binary, the configuration file and the existing files of its ATTACH commands (not those of
+// nested DO files; terminal multiplexers attach ports, not files)
+vector<SnapshotStore::TrackedFile> SnapshotStore::get_tracked_files(const char *binary_path, const ConfigurationEntry &entry) {
+	auto resolve = [&](const string &path) {
+		return (path.empty() || path[0] == '/') ? path : entry.directory + "/" + path;
+	};
+
+	vector<string> paths = {binary_path, resolve(entry.configuration_file)};
+
+	ifstream file(paths[1]);
+	string line;
+
+	while(std::getline(file, line)) {
+		vector<string> tokens;
+		size_t position = 0;
+
+		while(position < line.length()) {
+			while(position < line.length() && std::isspace((unsigned char) line[position])) {
+				position++;
+			}
+
+			if(position >= line.length() || line[position] == ';' || line[position] == '#') {
+				break;
+			}
+
+			string token;
+
+			if(line[position] == '"') {
+				size_t end = line.find('"', position + 1);
+				end = (end == string::npos) ? line.length() : end;
+
+				token = line.substr(position + 1, end - position - 1);
+				position = end + 1;
+			}
+			else {
+				while(position < line.length() && !std::isspace((unsigned char) line[position])) {
+					token += line[position++];
+				}
+			}
+
+			tokens.push_back(token);
+		}
+
+		if(tokens.empty()) {
+			continue;
+		}
+
+		// ATTACH may be abbreviated down to AT
+		string command = tokens[0];
+		std::transform(command.begin(), command.end(), command.begin(), [](unsigned char c) { return std::tolower(c); });
+
+		if(command.length() < 2 || string("attach").compare(0, command.length(), command) != 0) {
+			continue;
+		}
+
+		// ATTACH [-switches] <unit> <file>
+		size_t index = 1;
+
+		while(index < tokens.size() && tokens[index][0] == '-') {
+			index++;
+		}
+
+		if(index + 1 < tokens.size()) {
+			paths.push_back(resolve(tokens[index + 1]));
+		}
+	}
+
+	vector<TrackedFile> files;
+
+	for(size_t i = 0; i < paths.size(); i++) {
+		TrackedFile tracked;
+		read_file_state(paths[i], tracked);
+
+		if(i < 2 || tracked.size >= 0) {
+			files.push_back(tracked);
+		}
+	}
+
+	return files;
+}
+
+bool SnapshotStore::read_state(const string &path, double &guest_time_s, vector<TrackedFile> &files) const {
+	ifstream file(path);
+
+	if(!file.is_open()) {
+		return false;
+	}
+
+	string line;
+
+	if(!std::getline(file, line) || sscanf(line.c_str(), "guest_time %lf", &guest_time_s) != 1) {
+		return false;
+	}
+
+	files.clear();
+
+	while(std::getline(file, line)) {
+		stringstream stream(line);
+		TrackedFile tracked;
+
+		if(!(stream >> tracked.size >> tracked.mtime_ns)) {
+			return false;
+		}
+
+		stream.get();
+		std::getline(stream, tracked.path);
+
+		files.push_back(tracked);
+	}
+
+	return true;
+}
+
+// Connects to the remote console, waits for its prompt and runs <command>
+bool SnapshotStore::send_remote_command(const string &command, string &output) const {
+	int socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if(socket_fd < 0) {
+		logger->error("[SNAPSHOT] socket() failed: %s\n", strerror(errno));
+		return false;
+	}
+
+	struct sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(remote_console_port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if(connect(socket_fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+		logger->error("[SNAPSHOT] Cannot connect to the remote console on port %u: %s\n", remote_console_port, strerror(errno));
+
+		close(socket_fd);
+		return false;
+	}
+
+	// Telnet negotiation and banners are skipped, only the prompt matters
+	auto wait_prompt = [&](uint64_t timeout_ns, string &received) {
+		uint64_t deadline_ns = monotonic_time_ns() + timeout_ns;
+
+		while(received.find("sim> ") == string::npos) {
+			uint64_t now_ns = monotonic_time_ns();
+
+			if(now_ns >= deadline_ns) {
+				return false;
+			}
+
+			struct pollfd descriptor = {socket_fd, POLLIN, 0};
+
+			if(poll(&descriptor, 1, (int) ((deadline_ns - now_ns) / 1000000) + 1) <= 0) {
+				continue;
+			}
+
+			char buffer[512];
+			ssize_t count = read(socket_fd, buffer, sizeof(buffer));
+
+			if(count <= 0) {
+				return false;
+			}
+
+			received.append(buffer, count);
+		}
+
+		return true;
+	};
+
+	string received;
+	bool success = wait_prompt(PROMPT_TIMEOUT_NS, received);
+
+	// Sessions that are not in command mode get there with the WRU character (^E)
+	if(!success) {
+		success = (write(socket_fd, "\005", 1) == 1) && wait_prompt(PROMPT_TIMEOUT_NS, received);
+	}
+
+	if(!success) {
+		logger->error("[SNAPSHOT] No command prompt on the remote console on port %u\n", remote_console_port);
+
+		close(socket_fd);
+		return false;
+	}
+
+	string line = command + "\r\n";
+	received.clear();
+
+	success = (write(socket_fd, line.data(), line.length()) == (ssize_t) line.length()) && wait_prompt(SAVE_TIMEOUT_NS, received);
+
+	close(socket_fd);
+
+	output.clear();
+
+	for(char c : received.substr(0, received.rfind("sim> "))) {
+		if(std::isprint((unsigned char) c)) {
+			output += c;
+		}
+	}
+
+	if(!success) {
+		logger->error("[SNAPSHOT] No answer from the remote console to: %s\n", command.c_str());
+	}
+
+	return success;
+}
+
+bool SnapshotStore::save(const char *binary_path, const ConfigurationEntry &entry, double guest_time_s) {
+	string base_path = get_base_path(entry);
+	string snapshot_path = base_path + ".sav";
+	string state_path = base_path + ".state";
+
+	// The previous snapshot is invalid from here on, whatever happens
+	unlink(state_path.c_str());
+
+	uint64_t start_ns = monotonic_time_ns();
+
+	string output;
+
+	if(!send_remote_command("SAVE \"" + snapshot_path + ".tmp\"", output)) {
+		return false;
+	}
+
+	TrackedFile snapshot;
+	read_file_state(snapshot_path + ".tmp", snapshot);
+
+	if(output.find("rror") != string::npos || output.find("not allowed") != string::npos || snapshot.size <= 0) {
+		logger->error("[SNAPSHOT] SAVE failed: %s\n", output.c_str());
+		return false;
+	}
+
+	if(rename((snapshot_path + ".tmp").c_str(), snapshot_path.c_str()) != 0) {
+		logger->error("[SNAPSHOT] Cannot rename the snapshot to %s: %s\n", snapshot_path.c_str(), strerror(errno));
+		return false;
+	}
+
+	FILE *file = fopen((state_path + ".tmp").c_str(), "w");
+
+	if(!file) {
+		logger->error("[SNAPSHOT] Cannot write %s: %s\n", state_path.c_str(), strerror(errno));
+		return false;
+	}
+
+	fprintf(file, "guest_time %.3f\n", guest_time_s);
+
+	for(const TrackedFile &tracked : get_tracked_files(binary_path, entry)) {
+		fprintf(file, "%lld %lld %s\n", (long long) tracked.size, (long long) tracked.mtime_ns, tracked.path.c_str());
+	}
+
+	bool written = (fclose(file) == 0) && rename((state_path + ".tmp").c_str(), state_path.c_str()) == 0;
+
+	if(!written) {
+		logger->error("[SNAPSHOT] Cannot write %s\n", state_path.c_str());
+		return false;
+	}
+
+	logger->info("[SNAPSHOT] Saved entry %06o to %s (%lld bytes, %.1f s of guest run time) in %.1f ms\n",
+		entry.switch_code, snapshot_path.c_str(), (long long) snapshot.size, guest_time_s, (monotonic_time_ns() - start_ns) / 1e6);
+
+	return true;
+}
+
+bool SnapshotStore::prepare_restore(const char *binary_path, const ConfigurationEntry &entry, string &configuration_file, double &guest_time_s) {
+	string base_path = get_base_path(entry);
+
+	vector<TrackedFile> saved;
+	double saved_guest_time_s;
+
+	if(!read_state(base_path + ".state", saved_guest_time_s, saved)) {
+		return false;
+	}
+
+	vector<TrackedFile> current = get_tracked_files(binary_path, entry);
+
+	if(saved.size() != current.size()) {
+		logger->info("[SNAPSHOT] Snapshot of entry %06o is stale: the attached files changed\n", entry.switch_code);
+		return false;
+	}
+
+	for(size_t i = 0; i < saved.size(); i++) {
+		if(saved[i].path != current[i].path || saved[i].size != current[i].size || saved[i].mtime_ns != current[i].mtime_ns) {
+			logger->info("[SNAPSHOT] Snapshot of entry %06o is stale: %s changed\n", entry.switch_code, current[i].path.c_str());
+			return false;
+		}
+	}
+
+	string restore_path = base_path + ".ini";
+
+	FILE *file = fopen(restore_path.c_str(), "w");
+
+	if(!file) {
+		logger->error("[SNAPSHOT] Cannot write %s: %s\n", restore_path.c_str(), strerror(errno));
+		return false;
+	}
+
+	fprintf(file, "; Resumes entry %06o from its snapshot\n", entry.switch_code);
+	fprintf(file, "do \"%s\"\n", entry.configuration_file.c_str());
+	fprintf(file, "restore \"%s.sav\"\n", base_path.c_str());
+
+	if(fclose(file) != 0) {
+		logger->error("[SNAPSHOT] Cannot write %s\n", restore_path.c_str());
+		return false;
+	}
+
+	configuration_file = restore_path;
+	guest_time_s = saved_guest_time_s;
+
+	return true;
+}
+
+void SnapshotStore::record_session(bool restored, uint64_t first_instruction_ns, double skipped_s) {
+	if(restored) {
+		restores++;
+		restore_sum_ns += first_instruction_ns;
+		restore_skipped_sum_s += skipped_s;
+	}
+	else {
+		boots++;
+		boot_sum_ns += first_instruction_ns;
+	}
+}
+
+void SnapshotStore::report_statistics(bool reset) {
+	logger->info("[SNAPSHOT] Booted: %llu sessions, %.1f ms to the first instruction (avg)\n",
+		(unsigned long long) boots, boots ? boot_sum_ns / 1e6 / boots : 0.0);
+	logger->info("[SNAPSHOT] Restored: %llu sessions, %.1f ms to the first instruction (avg), skipping %.1f s of guest run time (avg)\n",
+		(unsigned long long) restores, restores ? restore_sum_ns / 1e6 / restores : 0.0, restores ? restore_skipped_sum_s / restores : 0.0);
+
+	if(reset) {
+		boots = 0;
+		boot_sum_ns = 0;
+		restores = 0;
+		restore_sum_ns = 0;
+		restore_skipped_sum_s = 0;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "configuration.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using std::string;
+using std::vector;
+
+// =============================================================
+// Simulator snapshots
+// =============================================================
+
+// Simulator state saved per configuration entry (SIMH SAVE), so that a later session
+// for the same switch code resumes the guest (RESTORE) instead of booting it
+// sim_frontpanel cannot run arbitrary simulator commands, so:
+// - SAVE is sent over a second connection to the remote console of the simulator
+// - RESTORE is done by starting the simulator with a generated configuration file that
+//   runs the configuration of the entry, then restores the snapshot
+// A snapshot is only used while the simulator binary, the configuration file and the
+// files it attaches have the size and modification time they had when it was saved
+
+class SnapshotStore {
+private:
+	struct TrackedFile {
+		string path;
+		int64_t size;
+		int64_t mtime_ns;
+	};
+
+	// Time allowed for the remote console to answer, and for SAVE to complete
+	static constexpr uint64_t PROMPT_TIMEOUT_NS = 2000000000;
+	static constexpr uint64_t SAVE_TIMEOUT_NS = 60000000000;
+
+	string directory;
+	unsigned int remote_console_port;
+
+	// Statistics: restart to first instruction, for booted and restored sessions
+	uint64_t boots;
+	uint64_t boot_sum_ns;
+	uint64_t restores;
+	uint64_t restore_sum_ns;
+	double restore_skipped_sum_s;
+
+	bool initialized;
+
+	string get_base_path(const ConfigurationEntry &entry) const;
+
+	static void read_file_state(const string &path, TrackedFile &file);
+	static vector<TrackedFile> get_tracked_files(const char *binary_path, const ConfigurationEntry &entry);
+
+	bool read_state(const string &path, double &guest_time_s, vector<TrackedFile> &files) const;
+
+	bool send_remote_command(const string &command, string &output) const;
+
+public:
+	SnapshotStore(const string &directory, unsigned int remote_console_port);
+
+	bool init();
+
+	// Saves the state of the halted simulator of <entry>, which ran <guest_time_s> since it booted
+	bool save(const char *binary_path, const ConfigurationEntry &entry, double guest_time_s);
+
+	// When a valid snapshot exists: the configuration file that restores it, and the run time it skips
+	bool prepare_restore(const char *binary_path, const ConfigurationEntry &entry, string &configuration_file, double &guest_time_s);
+
+	void record_session(bool restored, uint64_t first_instruction_ns, double skipped_s);
+
+	void report_statistics(bool reset);
+
+	bool is_initialized() const { return initialized; }
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,35 @@
+#include "switch_events.h"
+
+SwitchEventQueue::SwitchEventQueue():
+	events{},
+	head{0},
+	tail{0},
+	dropped{0} {
+}
+
+bool SwitchEventQueue::push(const SwitchEvent &event) {
+	uint32_t current_tail = tail.load(std::memory_order_relaxed);
+
+	if(current_tail - head.load(std::memory_order_acquire) == CAPACITY) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	events[current_tail % CAPACITY] = event;
+	tail.store(current_tail + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool SwitchEventQueue::pop(SwitchEvent &event) {
+	uint32_t current_head = head.load(std::memory_order_relaxed);
+
+	if(current_head == tail.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	event = events[current_head % CAPACITY];
+	head.store(current_head + 1, std::memory_order_release);
+
+	return true;
+}
@@ -0,0 +1,52 @@
+#ifndef SWITCH_EVENTS_H
+#define SWITCH_EVENTS_H
+
+#include <atomic>
+#include <cstdint>
+
+// =============================================================
+// Switch events
+// =============================================================
+
+struct SwitchEvent {
+	// When the change was first sampled, before debouncing (CLOCK_MONOTONIC)
+	uint64_t timestamp_ns;
+
+	// Sequence number of the published switch sample that includes the change
+	uint32_t sequence;
+
+	// Matrix position: row * 12 + column
+	uint8_t switch_id;
+
+	// True when the switch closed
+	bool level;
+};
+
+// Lock-free single-producer (scanner thread), single-consumer (panel logic) ring buffer
+// When the ring is full, new events are dropped and counted
+
+class SwitchEventQueue {
+private:
+	static constexpr uint32_t CAPACITY = 256;
+
+	SwitchEvent events[CAPACITY];
+
+	// Free-running counters, the slot is the counter modulo CAPACITY
+	std::atomic<uint32_t> head;
+	std::atomic<uint32_t> tail;
+
+	std::atomic<uint64_t> dropped;
+
+public:
+	SwitchEventQueue();
+
+	// Producer side
+	bool push(const SwitchEvent &event);
+
+	// Consumer side
+	bool pop(SwitchEvent &event);
+
+	uint64_t get_dropped() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#endif // SWITCH_EVENTS_H
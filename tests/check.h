@@ -0,0 +1,20 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+
+// =============================================================
+// Test helpers
+// =============================================================
+
+#define CHECK(condition) \
+	do { \
+		if(!(condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while(0)
+
+static int failures = 0;
+
+#endif // CHECK_H
@@ -0,0 +1,119 @@
+#ifndef SIMULATED_MATRIX_H
+#define SIMULATED_MATRIX_H
+
+#include "check.h"
+
+#include "../gpio_simulated.h"
+#include "../logger.h"
+#include "../scanner.h"
+#include "../timing.h"
+
+#include <cstdio>
+
+// =============================================================
+// Simulated panel
+// =============================================================
+
+// Same pins as the panel (see frontpanel.cpp)
+static const unsigned LED_ROWS[6] = {20, 21, 22, 23, 24, 25};
+static const unsigned SWITCH_ROWS[3]  = {16, 17, 18};
+static const unsigned COLS[12]    = {26, 27, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+
+constexpr unsigned int SWITCH_SETTLE_NS = 20000;
+
+// Short debounce times, so that tests do not wait for the ones of the panel
+static const DebounceConfiguration TEST_DEBOUNCE = {
+	{{1000, 1000}, {1000, 1000}, {0, 0}},
+	{{0xFFF, 0x3FF, 0x060}, {0x000, 0xC00, 0x09F}, {0x000, 0x000, 0xF00}}
+};
+
+static const ScannerConfiguration TEST_SCANNER = {100, 0, -1, TEST_DEBOUNCE, {{8, 9}, {10, 11}}, false, {{0, 0, 0}}};
+
+// =============================================================
+// SimulatedMatrix: the scanner running on a simulated panel
+// =============================================================
+
+// Set up like init_gpio() does it for the simulated backend
+
+class SimulatedMatrix {
+public:
+	SimulatedPanel panel;
+	GPIOGroup *matrix;
+	PanelScanner *scanner;
+
+	SimulatedMatrix():
+		panel(vector<unsigned int>(LED_ROWS, LED_ROWS + 6),
+			vector<unsigned int>(SWITCH_ROWS, SWITCH_ROWS + 3),
+			vector<unsigned int>(COLS, COLS + 12),
+			SWITCH_SETTLE_NS),
+		matrix{nullptr},
+		scanner{nullptr} {
+	}
+
+	~SimulatedMatrix() {
+		finish();
+	}
+
+	bool init(const ScannerConfiguration &configuration) {
+		logger = new Logger();
+		logger->init(false, "test");
+
+		precision_timer = new PrecisionTimer();
+
+		if(!precision_timer->init() || !panel.init()) {
+			return false;
+		}
+
+		vector<unsigned int> matrix_pins;
+
+		matrix_pins.insert(matrix_pins.end(), LED_ROWS, LED_ROWS + 6);
+		matrix_pins.insert(matrix_pins.end(), SWITCH_ROWS, SWITCH_ROWS + 3);
+		matrix_pins.insert(matrix_pins.end(), COLS, COLS + 12);
+
+		matrix = panel.create_group(matrix_pins);
+
+		if(!matrix->init() || !matrix->pin_mode(PinMode::Output)) {
+			return false;
+		}
+
+		scanner = new PanelScanner(matrix, configuration);
+
+		return scanner->init();
+	}
+
+	void finish() {
+		delete scanner;
+		scanner = nullptr;
+
+		delete matrix;
+		matrix = nullptr;
+
+		panel.finish();
+
+		delete precision_timer;
+		precision_timer = nullptr;
+
+		if(logger) {
+			logger->finish();
+			delete logger;
+			logger = nullptr;
+		}
+	}
+
+	// Waits until the scanner published <samples> more switch samples
+	bool wait_samples(uint32_t samples, unsigned int timeout_ms) {
+		uint32_t sequence = scanner->get_sequence();
+
+		for(unsigned int waited_ms = 0; waited_ms <= timeout_ms; waited_ms++) {
+			if(scanner->get_sequence() - sequence >= samples) {
+				return true;
+			}
+
+			precision_timer->sleep_ns(1000000);
+		}
+
+		return false;
+	}
+};
+
+#endif // SIMULATED_MATRIX_H
@@ -0,0 +1,92 @@
+#include "simulated_matrix.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// =============================================================
+// Allocation counter
+// =============================================================
+
+// Every other form of operator new ends up in this one
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if(void *pointer = malloc(size ? size : 1)) {
+		return pointer;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+	free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+	free(pointer);
+}
+
+// =============================================================
+// Test
+// =============================================================
+
+// The panel frames: LED rows and switch reads in the scanner thread, frames published and
+// switches read by the panel logic, must not allocate once the scanner is running
+int main() {
+	SimulatedMatrix matrix;
+
+	if(!matrix.init(TEST_SCANNER) || !matrix.scanner->start()) {
+		fprintf(stderr, "Cannot start the scanner on the simulated panel\n");
+		return 1;
+	}
+
+	// Thread creation and the first frames are not part of the measurement
+	CHECK(matrix.wait_samples(10, 1000));
+
+	uint64_t allocations_before = allocations.load();
+	uint32_t sequence_before = matrix.scanner->get_sequence();
+
+	LEDFrame frame = {};
+	uint16_t switches[3];
+	SwitchEvent event;
+
+	for(int step = 0; step < 50; step++) {
+		for(int led_row = 0; led_row < 6; led_row++) {
+			frame.set_row(led_row, (uint16_t) (step * 37 + led_row * 11) & COLS_MASK);
+		}
+
+		frame.set_level(0, step % 12, step % (LED_BRIGHTNESS_MAX + 1));
+
+		matrix.scanner->publish_frame(frame);
+
+		// Switch changes go through the debouncer and the event queue
+		matrix.panel.set_switch(step % 3, (step * 5) % 12, step & 1);
+
+		matrix.scanner->get_switches(switches);
+
+		while(matrix.scanner->pop_switch_event(event)) {
+		}
+
+		precision_timer->sleep_ns(5000000);
+	}
+
+	uint64_t frame_allocations = allocations.load() - allocations_before;
+	uint32_t samples = matrix.scanner->get_sequence() - sequence_before;
+
+	matrix.scanner->stop();
+
+	printf("test_allocations: %u switch samples, %llu allocations\n", samples, (unsigned long long) frame_allocations);
+
+	// The setup allocates, which shows the counter is the operator new in use
+	CHECK(allocations_before > 0);
+
+	CHECK(samples > 0);
+	CHECK(frame_allocations == 0);
+
+	matrix.finish();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+#include "check.h"
+
+#include "../display_rate.h"
+
+constexpr unsigned int SAMPLE_DEPTH = 100;
+constexpr uint64_t FRAME_PERIOD_NS = 10000000;
+
+static const DisplayRateConfiguration INTERVALS = {5000, 500000};
+
+// =============================================================
+// Option
+// =============================================================
+
+static void test_parse_update_interval() {
+	struct Case {
+		const char *option;
+		bool valid;
+		unsigned int min_interval_us;
+		unsigned int max_interval_us;
+	};
+
+	const Case cases[] = {
+		{"5,500", true, 5000, 500000},
+		{"0.5,0.5", true, 500, 500},
+		{"0.001,1", true, 1, 1000},
+		{"0.0001,1", false, 0, 0},
+		{"0,1", false, 0, 0},
+		{"-1,1", false, 0, 0},
+		{"5,1", false, 0, 0},
+		{"1,5000000", false, 0, 0},
+		{"nan,1", false, 0, 0},
+		{"1,nan", false, 0, 0},
+		{"5", false, 0, 0},
+		{"5,500x", false, 0, 0}
+	};
+
+	for(const Case &test : cases) {
+		DisplayRateConfiguration configuration = {0, 0};
+		bool valid = parse_update_interval_option(test.option, configuration);
+
+		if(valid != test.valid || (valid && (configuration.min_interval_us != test.min_interval_us || configuration.max_interval_us != test.max_interval_us))) {
+			fprintf(stderr, "--update-interval %s: %s, %u-%u us\n", test.option, valid ? "accepted" : "rejected", configuration.min_interval_us, configuration.max_interval_us);
+			failures++;
+		}
+	}
+}
+
+// =============================================================
+// Sample frequency
+// =============================================================
+
+// Simulation times of updates once per frame from <start_ns> on, for a guest at <rate> instructions/s
+static uint64_t run_guest(DisplayRateController &controller, uint64_t simulation_time, uint64_t start_ns, double rate, int updates) {
+	for(int update = 0; update < updates; update++) {
+		controller.record_simulation_time(simulation_time, start_ns + update * FRAME_PERIOD_NS);
+		simulation_time += (uint64_t) (rate * FRAME_PERIOD_NS / 1e9);
+	}
+
+	return simulation_time;
+}
+
+// The samples of one update cover the instructions run in the interval
+static void test_sample_frequency() {
+	const double rates[] = {1e6, 20e6, 100e3, 5e3};
+
+	for(double rate : rates) {
+		DisplayRateController controller(INTERVALS, SAMPLE_DEPTH, {10000, 1});
+		DisplayRate result;
+
+		run_guest(controller, 0, 1000000000, rate, 20);
+
+		// No handling cost: one update per 10 ms frame
+		controller.update(FRAME_PERIOD_NS, true, false, 2000000000, result);
+
+		unsigned int expected = (unsigned int) (rate * 0.01 / SAMPLE_DEPTH + 0.5);
+		expected = expected ? expected : 1;
+
+		if(result.interval_us != 10000 || result.sample_frequency != expected) {
+			fprintf(stderr, "%.0f instructions/s: every %u us, sampled every %u instructions (expected %u)\n", rate, result.interval_us, result.sample_frequency, expected);
+			failures++;
+		}
+	}
+}
+
+// Nothing is known before the first updates, and the halted time is not run time
+static void test_halted_time() {
+	DisplayRateController controller(INTERVALS, SAMPLE_DEPTH, {10000, 1});
+	DisplayRate result;
+
+	controller.update(FRAME_PERIOD_NS, true, false, 1000000000, result);
+	CHECK(result.sample_frequency == 1);
+
+	uint64_t simulation_time = run_guest(controller, 0, 1000000000, 1e6, 20);
+
+	CHECK(controller.get_instruction_rate() > 0.99e6 && controller.get_instruction_rate() < 1.01e6);
+
+	// Halted for 10 s, then running on
+	controller.update(FRAME_PERIOD_NS, false, false, 2000000000, result);
+	run_guest(controller, simulation_time, 12000000000, 1e6, 20);
+
+	CHECK(controller.get_instruction_rate() > 0.99e6 && controller.get_instruction_rate() < 1.01e6);
+}
+
+int main() {
+	test_parse_update_interval();
+	test_sample_frequency();
+	test_halted_time();
+
+	printf("test_display_rate: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
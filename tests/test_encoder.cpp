@@ -0,0 +1,103 @@
+#include "check.h"
+
+#include "../encoder.h"
+
+#include <vector>
+
+using std::vector;
+
+// =============================================================
+// Quadrature decoding
+// =============================================================
+
+// Samples of (A << 1) | B, the first one only seeds the decoder
+
+struct DecoderCase {
+	const char *name;
+	vector<uint8_t> states;
+
+	uint64_t sample_interval_ns;
+	bool acceleration;
+
+	uint64_t detents;
+	int32_t steps;
+	uint64_t illegal_transitions;
+};
+
+constexpr uint64_t SLOW_NS = 20000000;
+constexpr uint64_t FAST_NS = 2000000;
+
+static const DecoderCase DECODER_CASES[] = {
+	{"clockwise detent", {0, 1, 3, 2, 0}, SLOW_NS, false, 1, +1, 0},
+	{"counterclockwise detent", {0, 2, 3, 1, 0}, SLOW_NS, false, 1, -1, 0},
+	{"detent from another state", {3, 2, 0, 1, 3}, SLOW_NS, false, 1, +1, 0},
+	{"three transitions are no detent", {0, 1, 3, 2}, SLOW_NS, false, 0, 0, 0},
+	{"turned back before the detent", {0, 1, 3, 1, 0}, SLOW_NS, false, 0, 0, 0},
+	{"bounce on the first edge", {0, 1, 0, 1, 3, 2, 0}, SLOW_NS, false, 1, +1, 0},
+	{"repeated samples", {0, 0, 1, 1, 3, 3, 2, 2, 0, 0}, SLOW_NS, false, 1, +1, 0},
+	{"two detents", {0, 1, 3, 2, 0, 1, 3, 2, 0}, SLOW_NS, false, 2, +2, 0},
+	{"both inputs changed", {0, 3, 0}, SLOW_NS, false, 0, 0, 2},
+	{"illegal transition skips an edge", {0, 1, 2, 0, 1, 3, 2, 0}, SLOW_NS, false, 1, +1, 1},
+	{"every illegal transition", {0, 3, 0, 1, 2, 1}, SLOW_NS, false, 0, 0, 4},
+	{"fast detents without acceleration", {0, 1, 3, 2, 0, 1, 3, 2, 0}, FAST_NS, false, 2, +2, 0},
+	{"slow detents with acceleration", {0, 1, 3, 2, 0, 1, 3, 2, 0}, SLOW_NS, true, 2, +2, 0},
+	{"fast detents with acceleration", {0, 2, 3, 1, 0, 2, 3, 1, 0}, FAST_NS, true, 2, -4, 0}
+};
+
+static void test_decoder_cases() {
+	for(const DecoderCase &test : DECODER_CASES) {
+		QuadratureDecoder decoder;
+		uint64_t now_ns = 1000000000;
+		uint64_t completed = 0;
+
+		decoder.set_acceleration(test.acceleration);
+
+		for(uint8_t state : test.states) {
+			completed += decoder.update(state & 2, state & 1, now_ns);
+			now_ns += test.sample_interval_ns;
+		}
+
+		int32_t steps = decoder.take_steps();
+
+		if(completed != test.detents || decoder.get_detents() != test.detents || steps != test.steps ||
+			decoder.get_illegal_transitions() != test.illegal_transitions) {
+			fprintf(stderr, "%s: %llu detents (%llu reported), %d steps, %llu illegal transitions\n", test.name,
+				(unsigned long long) decoder.get_detents(), (unsigned long long) completed, steps,
+				(unsigned long long) decoder.get_illegal_transitions());
+			failures++;
+		}
+
+		// Steps are only handed out once
+		CHECK(decoder.take_steps() == 0);
+	}
+}
+
+// Every one of the four transitions of a detent is needed, in either direction
+static void test_transitions_per_detent() {
+	const uint8_t clockwise[4] = {1, 3, 2, 0};
+
+	for(int turns = 1; turns <= 3; turns++) {
+		QuadratureDecoder decoder;
+
+		decoder.update(false, false, 0);
+
+		for(int transition = 0; transition < 4 * turns; transition++) {
+			uint8_t state = clockwise[transition % 4];
+			bool completed = decoder.update(state & 2, state & 1, 0);
+
+			CHECK(completed == (transition % 4 == 3));
+		}
+
+		CHECK(decoder.get_detents() == (uint64_t) turns);
+		CHECK(decoder.take_steps() == turns);
+	}
+}
+
+int main() {
+	test_decoder_cases();
+	test_transitions_per_detent();
+
+	printf("test_encoder: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+#include "check.h"
+
+#include "../examine_cache.h"
+
+// A long EXAM dump fills the cache: the fetch an EXAM waits for must survive the eviction
+static void test_capacity_keeps_fetches() {
+	ExamineCache cache;
+	uint64_t command_id = 1;
+	uint16_t value;
+
+	// Words examined ahead and arrived
+	for(uint32_t address = 0; address < ExamineCache::CAPACITY - 1; address++) {
+		cache.fetching(address, command_id);
+		CHECK(cache.fill(address, command_id, true, (uint16_t) address));
+		command_id++;
+	}
+
+	// The EXAM waits for this one, then the prefetch of the next words goes past the capacity
+	uint32_t waited_address = ExamineCache::CAPACITY - 1;
+	uint64_t waited_id = command_id++;
+
+	cache.fetching(waited_address, waited_id);
+
+	for(uint32_t address = waited_address + 1; address < waited_address + 8; address++) {
+		cache.fetching(address, command_id++);
+	}
+
+	CHECK(cache.contains(waited_address));
+	CHECK(cache.fill(waited_address, waited_id, true, 0123));
+	CHECK(cache.lookup(waited_address, value) && value == 0123);
+
+	// The examined words were dropped instead, and are examined again
+	CHECK(!cache.contains(0));
+}
+
+// Results of fetches issued before an invalidation are discarded
+static void test_invalidate() {
+	ExamineCache cache;
+	uint16_t value;
+
+	cache.fetching(01000, 1);
+	cache.invalidate();
+
+	CHECK(!cache.fill(01000, 1, true, 1));
+	CHECK(!cache.lookup(01000, value));
+
+	// A later fetch of the same word only takes its own result
+	cache.fetching(01000, 2);
+
+	CHECK(!cache.fill(01000, 1, true, 1));
+	CHECK(cache.fill(01000, 2, true, 2));
+	CHECK(cache.lookup(01000, value) && value == 2);
+}
+
+// A failed fetch leaves the word to be examined again
+static void test_failed_fetch() {
+	ExamineCache cache;
+	uint16_t value;
+
+	cache.fetching(02000, 1);
+
+	CHECK(cache.fill(02000, 1, false, 0));
+	CHECK(!cache.contains(02000));
+	CHECK(!cache.lookup(02000, value));
+}
+
+int main() {
+	test_capacity_keeps_fetches();
+	test_invalidate();
+	test_failed_fetch();
+
+	printf("test_examine_cache: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
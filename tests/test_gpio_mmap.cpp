@@ -0,0 +1,219 @@
+#include "simulated_matrix.h"
+
+#include "../gpio_mmap.h"
+
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Register offsets, in 32-bit words (see gpio_mmap.cpp)
+constexpr unsigned int REGISTER_GPFSEL0 = 0x00 / 4;
+constexpr unsigned int REGISTER_GPSET0  = 0x1C / 4;
+constexpr unsigned int REGISTER_GPCLR0  = 0x28 / 4;
+constexpr unsigned int REGISTER_GPLEV0  = 0x34 / 4;
+
+constexpr size_t MAP_SIZE = 4096;
+
+// Group indexes of the matrix pins, in the order of init_gpio()
+constexpr uint32_t GROUP_LED_ROWS    = 0x3F << 0;
+constexpr uint32_t GROUP_SWITCH_ROWS = 0x07 << 6;
+constexpr uint32_t GROUP_COLS        = 0xFFF << 9;
+
+// =============================================================
+// Register file
+// =============================================================
+
+// A temporary register image, mapped a second time to look at what the backend wrote
+
+class RegisterFile {
+public:
+	char path[32];
+	int file_descriptor;
+	volatile uint32_t *registers;
+
+	RegisterFile():
+		path("/tmp/test_gpio_mmap.XXXXXX"),
+		file_descriptor(-1),
+		registers(nullptr) {
+	}
+
+	~RegisterFile() {
+		if(registers) {
+			munmap(const_cast<uint32_t*>(registers), MAP_SIZE);
+		}
+
+		if(file_descriptor >= 0) {
+			close(file_descriptor);
+			unlink(path);
+		}
+	}
+
+	bool init() {
+		file_descriptor = mkstemp(path);
+
+		if(file_descriptor < 0 || ftruncate(file_descriptor, MAP_SIZE) != 0) {
+			return false;
+		}
+
+		void *mapping = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+
+		if(mapping == MAP_FAILED) {
+			return false;
+		}
+
+		registers = static_cast<volatile uint32_t*>(mapping);
+
+		return true;
+	}
+
+	unsigned int function(unsigned int pin) const {
+		return (registers[REGISTER_GPFSEL0 + pin / 10] >> ((pin % 10) * 3)) & 7;
+	}
+};
+
+static vector<unsigned int> matrix_pins() {
+	vector<unsigned int> pins;
+
+	pins.insert(pins.end(), LED_ROWS, LED_ROWS + 6);
+	pins.insert(pins.end(), SWITCH_ROWS, SWITCH_ROWS + 3);
+	pins.insert(pins.end(), COLS, COLS + 12);
+
+	return pins;
+}
+
+// Bank 0 bits of the matrix pins in a group mask
+static uint32_t to_bank_mask(uint32_t group_mask) {
+	vector<unsigned int> pins = matrix_pins();
+	uint32_t bank_mask = 0;
+
+	for(size_t i = 0; i < pins.size(); i++) {
+		if((group_mask >> i) & 1) {
+			bank_mask |= 1u << pins[i];
+		}
+	}
+
+	return bank_mask;
+}
+
+// =============================================================
+// Tests
+// =============================================================
+
+// Outputs go out through GPSET0/GPCLR0 and read back through the emulated GPLEV0
+static void test_set_clear() {
+	RegisterFile file;
+	CHECK(file.init());
+
+	GPIOMemory memory(file.path);
+	CHECK(memory.init());
+
+	GPIOGroup *matrix = memory.create_group(matrix_pins());
+	CHECK(matrix->init());
+	CHECK(matrix->pin_mode(PinMode::Output));
+
+	for(unsigned pin : matrix_pins()) {
+		CHECK(file.function(pin) == 1);
+	}
+
+	// LED row 2 on with some columns, the switch rows released
+	const uint32_t patterns[] = {
+		(1u << 2) | GROUP_SWITCH_ROWS | (0xA5A << 9),
+		(1u << 5) | GROUP_SWITCH_ROWS | (0x001 << 9),
+		GROUP_SWITCH_ROWS | GROUP_COLS,
+		0
+	};
+
+	for(uint32_t pattern : patterns) {
+		file.registers[REGISTER_GPSET0] = 0;
+		file.registers[REGISTER_GPCLR0] = 0;
+
+		CHECK(matrix->pins_set_mask(pattern));
+
+		CHECK(file.registers[REGISTER_GPSET0] == to_bank_mask(pattern));
+		CHECK(file.registers[REGISTER_GPCLR0] == to_bank_mask(~pattern & matrix->get_all_mask()));
+		CHECK(file.registers[REGISTER_GPLEV0] == to_bank_mask(pattern));
+
+		uint32_t levels;
+
+		CHECK(matrix->pins_get_mask(levels) && levels == pattern);
+	}
+
+	// Only the pins in the mask are written
+	file.registers[REGISTER_GPSET0] = 0;
+	file.registers[REGISTER_GPCLR0] = 0;
+
+	CHECK(matrix->pins_set_masked(GROUP_LED_ROWS, 1u << 4));
+	CHECK(file.registers[REGISTER_GPSET0] == to_bank_mask(1u << 4));
+	CHECK(file.registers[REGISTER_GPCLR0] == to_bank_mask(GROUP_LED_ROWS & ~(1u << 4)));
+
+	CHECK(matrix->pin_set(6, false));
+	CHECK(file.registers[REGISTER_GPCLR0] == (1u << SWITCH_ROWS[0]));
+	CHECK(!matrix->pin_get(6));
+
+	delete matrix;
+}
+
+// Columns read as inputs: each one reads the level the register has for its own pin
+static void test_read_columns() {
+	RegisterFile file;
+	CHECK(file.init());
+
+	GPIOMemory memory(file.path);
+	CHECK(memory.init());
+
+	GPIOGroup *matrix = memory.create_group(matrix_pins());
+	CHECK(matrix->init());
+	CHECK(matrix->pin_mode(PinMode::Output));
+	CHECK(matrix->pin_mode_mask(GROUP_COLS, PinMode::Input, PullMode::PullUp));
+
+	for(int i = 0; i < 21; i++) {
+		bool col = (GROUP_COLS >> i) & 1;
+
+		CHECK(file.function(matrix_pins()[i]) == (col ? 0u : 1u));
+	}
+
+	// Inputs cannot be driven
+	CHECK(!matrix->pins_set_mask(0));
+	CHECK(!matrix->pins_set_masked(GROUP_COLS, 0));
+	CHECK(matrix->pins_set_masked(GROUP_SWITCH_ROWS, GROUP_SWITCH_ROWS & ~(1u << 7)));
+
+	for(int col = 0; col < 12; col++) {
+		// Closed switches pull their column low
+		uint32_t open_cols = 0xFFF & ~(1u << col) & ~(1u << (11 - col));
+		uint32_t levels;
+
+		file.registers[REGISTER_GPLEV0] = to_bank_mask((open_cols << 9) | (GROUP_SWITCH_ROWS & ~(1u << 7)));
+
+		CHECK(matrix->pins_get_mask(levels));
+		CHECK(((levels & GROUP_COLS) >> 9) == open_cols);
+		CHECK(!matrix->pin_get(9 + col));
+	}
+
+	delete matrix;
+}
+
+// A group reaching past bank 0 is refused
+static void test_bank_0_only() {
+	RegisterFile file;
+	CHECK(file.init());
+
+	GPIOMemory memory(file.path);
+	CHECK(memory.init());
+
+	GPIOGroup *group = memory.create_group({4, 32});
+	CHECK(!group->init());
+
+	delete group;
+}
+
+int main() {
+	test_set_clear();
+	test_read_columns();
+	test_bank_0_only();
+
+	printf("test_gpio_mmap: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
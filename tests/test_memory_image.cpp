@@ -0,0 +1,190 @@
+#include "check.h"
+
+#include "../logger.h"
+#include "../memory_image.h"
+
+#include <cstdlib>
+#include <initializer_list>
+
+#include <unistd.h>
+
+// =============================================================
+// Tapes
+// =============================================================
+
+// One absolute loader block: header, byte count, load address, data, checksum
+static vector<uint8_t> block(uint32_t address, std::initializer_list<uint8_t> data) {
+	size_t count = 6 + data.size();
+	vector<uint8_t> bytes = {1, 0, (uint8_t) count, (uint8_t) (count >> 8), (uint8_t) address, (uint8_t) (address >> 8)};
+
+	bytes.insert(bytes.end(), data.begin(), data.end());
+
+	uint8_t sum = 0;
+
+	for(uint8_t byte : bytes) {
+		sum += byte;
+	}
+
+	bytes.push_back((uint8_t) -sum);
+
+	return bytes;
+}
+
+static vector<uint8_t> tape(std::initializer_list<vector<uint8_t>> blocks) {
+	vector<uint8_t> bytes;
+
+	for(const vector<uint8_t> &part : blocks) {
+		bytes.insert(bytes.end(), part.begin(), part.end());
+	}
+
+	return bytes;
+}
+
+static vector<uint8_t> leader(size_t count) {
+	return vector<uint8_t>(count, 0);
+}
+
+// The same tape with one byte changed, or cut short
+static vector<uint8_t> corrupted(vector<uint8_t> bytes, size_t offset, uint8_t value) {
+	bytes[offset] = value;
+	return bytes;
+}
+
+static vector<uint8_t> truncated(vector<uint8_t> bytes, size_t size) {
+	bytes.resize(size);
+	return bytes;
+}
+
+// =============================================================
+// Absolute loader
+// =============================================================
+
+struct ExpectedWord {
+	uint32_t address;
+	uint16_t value;
+	uint8_t byte_mask;
+};
+
+struct LoaderCase {
+	const char *name;
+	vector<uint8_t> bytes;
+
+	bool valid;
+	bool has_start;
+	uint32_t start_address;
+
+	vector<ExpectedWord> words;
+};
+
+static vector<LoaderCase> loader_cases() {
+	vector<uint8_t> program = tape({leader(8), block(01000, {0x01, 0x02, 0x03, 0x04}), leader(4), block(01000, {}), leader(8)});
+
+	return {
+		{"two words and a transfer address", program, true, true, 01000,
+			{{01000, 0x0201, 3}, {01002, 0x0403, 3}}},
+		{"two blocks", tape({block(02000, {0x11, 0x22}), block(02002, {0x33, 0x44}), block(02000, {})}), true, true, 02000,
+			{{02000, 0x2211, 3}, {02002, 0x4433, 3}}},
+		{"odd transfer address", tape({block(01000, {0x01, 0x02}), block(01001, {})}), true, false, 0,
+			{{01000, 0x0201, 3}}},
+		{"no transfer block", tape({block(01000, {0x01, 0x02}), leader(16)}), true, false, 0,
+			{{01000, 0x0201, 3}}},
+		{"half-filled words", tape({block(01001, {0xAA, 0xBB, 0xCC}), block(01000, {})}), true, true, 01000,
+			{{01000, 0xAA00, 2}, {01002, 0xCCBB, 3}}},
+		{"half-filled last word", tape({block(03000, {0x55, 0x66, 0x77}), block(03000, {})}), true, true, 03000,
+			{{03000, 0x6655, 3}, {03002, 0x0077, 1}}},
+		{"checksum error", corrupted(program, 8 + 7, 0xFF), false, false, 0, {}},
+		{"checksum error in the transfer block", corrupted(program, program.size() - 9, 0x55), false, false, 0, {}},
+		{"truncated data", truncated(program, 8 + 9), false, false, 0, {}},
+		{"truncated header", truncated(program, 8 + 4), false, false, 0, {}},
+		{"truncated checksum", truncated(program, 8 + 10), false, false, 0, {}},
+		{"bad header", corrupted(program, 8 + 1, 0x01), false, false, 0, {}},
+		{"byte count below the header", corrupted(program, 8 + 2, 4), false, false, 0, {}}
+	};
+}
+
+static bool write_file(const char *path, const vector<uint8_t> &bytes) {
+	FILE *file = fopen(path, "wb");
+
+	if(!file) {
+		return false;
+	}
+
+	bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+
+	return (fclose(file) == 0) && written;
+}
+
+static void test_absolute_loader(const char *path) {
+	for(const LoaderCase &test : loader_cases()) {
+		CHECK(write_file(path, test.bytes));
+
+		MemoryImage image(path);
+		bool valid = image.init();
+		uint32_t start_address = 0;
+		bool has_start = valid && image.get_start_address(start_address);
+
+		bool words_match = valid && image.get_words().size() == test.words.size();
+
+		for(const ExpectedWord &word : test.words) {
+			auto found = image.get_words().find(word.address);
+
+			words_match = words_match && found != image.get_words().end() &&
+				found->second.value == word.value && found->second.byte_mask == word.byte_mask;
+		}
+
+		if(valid != test.valid || has_start != test.has_start || (has_start && start_address != test.start_address) ||
+			(test.valid && !words_match)) {
+			fprintf(stderr, "%s: %s, start %s %06o, %zu words\n", test.name, valid ? "read" : "rejected",
+				has_start ? "at" : "none", start_address, image.get_words().size());
+			failures++;
+		}
+	}
+}
+
+// =============================================================
+// Raw images
+// =============================================================
+
+// Loaded from the address on, odd addresses included, and started at the word holding it
+static void test_raw(const char *path) {
+	CHECK(write_file(path, {0x01, 0x02, 0x03}));
+
+	MemoryImage image(path, 01001);
+	uint32_t start_address;
+
+	CHECK(image.init());
+	CHECK(image.get_start_address(start_address) && start_address == 01000);
+	CHECK(image.get_byte_count() == 3);
+	CHECK(image.get_words().size() == 2);
+	CHECK(image.get_words().at(01000).value == 0x0100 && image.get_words().at(01000).byte_mask == 2);
+	CHECK(image.get_words().at(01002).value == 0x0302 && image.get_words().at(01002).byte_mask == 3);
+
+	CHECK(write_file(path, {}));
+
+	MemoryImage empty(path, 01000);
+
+	CHECK(!empty.init());
+}
+
+int main() {
+	logger = new Logger();
+	logger->init(false, "test");
+
+	char path[] = "/tmp/test_memory_image.XXXXXX";
+	int file_descriptor = mkstemp(path);
+
+	CHECK(file_descriptor >= 0);
+	close(file_descriptor);
+
+	test_absolute_loader(path);
+	test_raw(path);
+
+	unlink(path);
+
+	logger->finish();
+	delete logger;
+
+	printf("test_memory_image: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
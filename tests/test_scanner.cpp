@@ -0,0 +1,281 @@
+#include "simulated_matrix.h"
+
+#include <algorithm>
+
+// Toggle debounce of the panel, long enough for a sample taken too early to miss the change
+static const DebounceConfiguration PANEL_DEBOUNCE = {
+	{{20000, 20000}, {5000, 10000}, {0, 0}},
+	{{0xFFF, 0x3FF, 0x060}, {0x000, 0xC00, 0x09F}, {0x000, 0x000, 0xF00}}
+};
+
+constexpr unsigned int WAIT_TIMEOUT_MS = 1000;
+
+static bool same_rows(const uint16_t a[3], const uint16_t b[3]) {
+	return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+static void set_switches(SimulatedPanel &panel, const uint16_t rows[3]) {
+	for(int row = 0; row < 3; row++) {
+		for(int col = 0; col < 12; col++) {
+			panel.set_switch(row, col, (rows[row] >> col) & 1);
+		}
+	}
+}
+
+// =============================================================
+// Switches
+// =============================================================
+
+// The first sample already has every row as it is, not the rows that were not read yet as open
+static void test_first_sample() {
+	SimulatedMatrix matrix;
+	uint16_t expected[3] = {05252, 01234, 0x0A5};
+
+	CHECK(matrix.init(TEST_SCANNER));
+
+	set_switches(matrix.panel, expected);
+
+	CHECK(matrix.scanner->start());
+
+	// Polled without sleeping, so that the sample seen is the first one or close to it
+	uint64_t deadline_ns = monotonic_time_ns() + WAIT_TIMEOUT_MS * 1000000ull;
+	uint16_t switches[3];
+
+	while(matrix.scanner->get_switches(switches) == 0 && monotonic_time_ns() < deadline_ns) {
+	}
+
+	CHECK(same_rows(switches, expected));
+}
+
+// A switch flipped just before wait_switches() is reported, with the debounce times of the panel
+static void test_wait_switches() {
+	SimulatedMatrix matrix;
+	ScannerConfiguration configuration = TEST_SCANNER;
+
+	configuration.debounce = PANEL_DEBOUNCE;
+
+	CHECK(matrix.init(configuration));
+	CHECK(matrix.scanner->start());
+	CHECK(matrix.wait_samples(1, WAIT_TIMEOUT_MS));
+
+	uint16_t expected[3] = {0, 0, 0};
+
+	for(int step = 0; step < 4; step++) {
+		expected[0] ^= 1u << (step * 3);
+		set_switches(matrix.panel, expected);
+
+		uint16_t switches[3];
+
+		CHECK(matrix.scanner->wait_switches(switches, WAIT_TIMEOUT_MS));
+		CHECK(same_rows(switches, expected));
+	}
+}
+
+// Every matrix position reads back at its own row and column, and queues an event for itself
+static void test_switch_positions() {
+	SimulatedMatrix matrix;
+
+	CHECK(matrix.init(TEST_SCANNER));
+	CHECK(matrix.scanner->start());
+	CHECK(matrix.wait_samples(1, WAIT_TIMEOUT_MS));
+
+	SwitchEvent event;
+
+	while(matrix.scanner->pop_switch_event(event)) {
+	}
+
+	for(int row = 0; row < 3; row++) {
+		for(int col = 0; col < 12; col++) {
+			uint16_t expected[3] = {0, 0, 0};
+			uint16_t switches[3];
+
+			expected[row] = 1u << col;
+
+			matrix.panel.set_switch(row, col, true);
+
+			CHECK(matrix.scanner->wait_switches(switches, WAIT_TIMEOUT_MS));
+			CHECK(same_rows(switches, expected));
+
+			// The rotation pins of the encoders are decoded as steps instead
+			bool encoder_pin = (row == ENCODER_SWITCH_ROW) && col >= 8;
+
+			if(!encoder_pin) {
+				CHECK(matrix.scanner->pop_switch_event(event) && event.switch_id == row * 12 + col && event.level);
+			}
+
+			matrix.panel.set_switch(row, col, false);
+
+			CHECK(matrix.scanner->wait_switches(switches, WAIT_TIMEOUT_MS));
+			CHECK(switches[row] == 0);
+
+			if(!encoder_pin) {
+				CHECK(matrix.scanner->pop_switch_event(event) && event.switch_id == row * 12 + col && !event.level);
+			}
+		}
+	}
+}
+
+// =============================================================
+// LEDs
+// =============================================================
+
+// Each LED is lit exactly when its bit is set in the published frame
+static void test_led_positions() {
+	SimulatedMatrix matrix;
+
+	CHECK(matrix.init(TEST_SCANNER));
+	CHECK(matrix.scanner->start());
+
+	const uint16_t patterns[2][6] = {
+		{0x001, 0x802, 0x0F0, 0xA5A, 0x3C3, 0xFFF},
+		{0xFFE, 0x7FD, 0xF0F, 0x5A5, 0xC3C, 0x000}
+	};
+
+	for(const auto &pattern : patterns) {
+		LEDFrame frame = {};
+
+		for(int led_row = 0; led_row < 6; led_row++) {
+			frame.set_row(led_row, pattern[led_row]);
+		}
+
+		matrix.scanner->publish_frame(frame);
+
+		// The frame being scanned when it was published may still be the previous one
+		CHECK(matrix.wait_samples(12, WAIT_TIMEOUT_MS));
+
+		uint64_t on_time_ns[6][12];
+
+		for(int led_row = 0; led_row < 6; led_row++) {
+			for(int col = 0; col < 12; col++) {
+				on_time_ns[led_row][col] = matrix.panel.get_led_on_time_ns(led_row, col);
+			}
+		}
+
+		CHECK(matrix.wait_samples(12, WAIT_TIMEOUT_MS));
+
+		for(int led_row = 0; led_row < 6; led_row++) {
+			for(int col = 0; col < 12; col++) {
+				bool lit = matrix.panel.get_led_on_time_ns(led_row, col) > on_time_ns[led_row][col];
+
+				if(lit != (bool) ((pattern[led_row] >> col) & 1)) {
+					fprintf(stderr, "LED row %d column %d is %s\n", led_row, col, lit ? "lit" : "dark");
+					failures++;
+				}
+			}
+		}
+	}
+}
+
+// =============================================================
+// Pin sequence
+// =============================================================
+
+// Replays the recorded transitions: a switch row is only driven low, and columns are only read,
+// while every LED row is off and the other switch rows are released
+static void test_pin_sequence() {
+	SimulatedMatrix matrix;
+	uint16_t closed[3] = {0xFFF, 0xFFF, 0xFFF};
+
+	CHECK(matrix.init(TEST_SCANNER));
+
+	set_switches(matrix.panel, closed);
+
+	// Stopping leaves LED rows low, switch rows and columns high outputs: the replay starts from there
+	CHECK(matrix.scanner->start());
+	CHECK(matrix.wait_samples(1, WAIT_TIMEOUT_MS));
+	matrix.scanner->stop();
+
+	matrix.panel.clear_transitions();
+
+	CHECK(matrix.scanner->start());
+	CHECK(matrix.wait_samples(30, WAIT_TIMEOUT_MS));
+	matrix.scanner->stop();
+
+	vector<PinTransition> transitions;
+	uint64_t count = matrix.panel.get_transitions(transitions);
+
+	CHECK(count > 0 && count == transitions.size());
+
+	bool output[64];
+	bool level[64];
+
+	std::fill(output, output + 64, true);
+	std::fill(level, level + 64, true);
+
+	for(unsigned pin : LED_ROWS) {
+		level[pin] = false;
+	}
+
+	uint64_t switch_row_reads = 0;
+
+	for(const PinTransition &transition : transitions) {
+		output[transition.pin] = transition.output;
+		level[transition.pin] = transition.level;
+
+		int lit_led_rows = 0;
+		int active_switch_rows = 0;
+		int input_cols = 0;
+
+		for(unsigned pin : LED_ROWS) {
+			lit_led_rows += level[pin];
+		}
+
+		for(unsigned pin : SWITCH_ROWS) {
+			active_switch_rows += !level[pin];
+		}
+
+		for(unsigned pin : COLS) {
+			input_cols += !output[pin];
+		}
+
+		if(active_switch_rows > 0) {
+			switch_row_reads++;
+
+			CHECK(lit_led_rows == 0);
+			CHECK(active_switch_rows == 1);
+			CHECK(input_cols == 12);
+		}
+	}
+
+	CHECK(switch_row_reads > 0);
+}
+
+// A write that includes a pin another group made an input is rejected as a whole: no pin before it changes
+static void test_rejected_write() {
+	SimulatedMatrix matrix;
+
+	CHECK(matrix.init(TEST_SCANNER));
+	CHECK(matrix.matrix->pins_set_mask(0x1FF));
+
+	GPIOGroup *cols = matrix.panel.create_group(vector<unsigned int>(COLS, COLS + 12));
+
+	CHECK(cols->init());
+	CHECK(cols->pin_mode(PinMode::Input, PullMode::PullUp));
+
+	matrix.panel.clear_transitions();
+
+	CHECK(!matrix.matrix->pins_set_masked(matrix.matrix->get_all_mask(), 0));
+
+	vector<PinTransition> transitions;
+
+	CHECK(matrix.panel.get_transitions(transitions) == 0);
+
+	for(int index = 0; index < 9; index++) {
+		CHECK(matrix.matrix->pin_get(index));
+	}
+
+	delete cols;
+}
+
+int main() {
+	test_first_sample();
+	test_wait_switches();
+	test_switch_positions();
+	test_led_positions();
+	test_pin_sequence();
+	test_rejected_write();
+
+	printf("test_scanner: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
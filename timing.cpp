@@ -0,0 +1,163 @@
+#include "timing.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+
+using std::vector;
+
+PrecisionTimer *precision_timer = nullptr;
+
+// =============================================================
+// Calibration constants
+// =============================================================
+
+constexpr int CALIBRATION_SAMPLES = 200;
+constexpr uint64_t CALIBRATION_SLEEP_NS = 50000;
+
+// Bounds for the time spent spinning before each deadline
+constexpr uint64_t MINIMUM_SPIN_NS = 5000;
+constexpr uint64_t MAXIMUM_SPIN_NS = 200000;
+
+// Used until the timer is calibrated
+constexpr uint64_t DEFAULT_SPIN_NS = 80000;
+
+static void sleep_until_absolute(uint64_t deadline_ns) {
+	struct timespec deadline = {(time_t) (deadline_ns / NS_PER_SECOND), (long) (deadline_ns % NS_PER_SECOND)};
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+	}
+}
+
+// =============================================================
+// PrecisionTimer
+// =============================================================
+
+PrecisionTimer::PrecisionTimer():
+	spin_threshold_ns{DEFAULT_SPIN_NS},
+	histogram{},
+	requested_sum_ns{},
+	actual_sum_ns{},
+	initialized{false} {
+}
+
+PrecisionTimer::~PrecisionTimer() {
+	finish();
+}
+
+bool PrecisionTimer::init() {
+	if(initialized) {
+		return true;
+	}
+
+	vector<uint64_t> overshoots;
+
+	overshoots.reserve(CALIBRATION_SAMPLES);
+
+	for(int i = 0; i < CALIBRATION_SAMPLES; i++) {
+		uint64_t deadline_ns = monotonic_time_ns() + CALIBRATION_SLEEP_NS;
+
+		sleep_until_absolute(deadline_ns);
+
+		overshoots.push_back(monotonic_time_ns() - deadline_ns);
+	}
+
+	std::sort(overshoots.begin(), overshoots.end());
+
+	uint64_t median_ns = overshoots[CALIBRATION_SAMPLES / 2];
+	uint64_t percentile_99_ns = overshoots[CALIBRATION_SAMPLES * 99 / 100];
+
+	// Wake up early enough for almost every sleep, then spin to the deadline
+	spin_threshold_ns = std::min(std::max(percentile_99_ns, MINIMUM_SPIN_NS), MAXIMUM_SPIN_NS);
+
+	logger->info("[TIMER] Sleep overshoot median %.1f us, 99th percentile %.1f us; spinning the last %.1f us\n",
+		median_ns / 1e3, percentile_99_ns / 1e3, spin_threshold_ns / 1e3);
+
+	initialized = true;
+
+	return true;
+}
+
+void PrecisionTimer::finish() {
+	initialized = false;
+}
+
+void PrecisionTimer::sleep_until_ns(uint64_t deadline_ns) {
+	uint64_t start_ns = monotonic_time_ns();
+
+	if(deadline_ns <= start_ns) {
+		return;
+	}
+
+	if(deadline_ns - start_ns > spin_threshold_ns) {
+		sleep_until_absolute(deadline_ns - spin_threshold_ns);
+	}
+
+	uint64_t now_ns = monotonic_time_ns();
+
+	while(now_ns < deadline_ns) {
+		now_ns = monotonic_time_ns();
+	}
+
+	record(deadline_ns - start_ns, now_ns - start_ns);
+}
+
+void PrecisionTimer::sleep_ns(uint64_t duration_ns) {
+	struct timespec time_specification = {(time_t) (duration_ns / NS_PER_SECOND), (long) (duration_ns % NS_PER_SECOND)};
+
+	nanosleep(&time_specification, nullptr);
+}
+
+void PrecisionTimer::record(uint64_t requested_ns, uint64_t actual_ns) {
+	int delay_class = (requested_ns < 10000) ? 0 : (requested_ns < 100000) ? 1 : (requested_ns < 1000000) ? 2 : 3;
+
+	uint64_t overshoot_ns = actual_ns - requested_ns;
+	int bucket = 0;
+
+	while(bucket < OVERSHOOT_BUCKETS - 1 && overshoot_ns >= OVERSHOOT_LIMITS_US[bucket] * 1000ull) {
+		bucket++;
+	}
+
+	histogram[delay_class][bucket].fetch_add(1, std::memory_order_relaxed);
+	requested_sum_ns[delay_class].fetch_add(requested_ns, std::memory_order_relaxed);
+	actual_sum_ns[delay_class].fetch_add(actual_ns, std::memory_order_relaxed);
+}
+
+void PrecisionTimer::report_statistics(bool reset) {
+	static const char *class_names[DELAY_CLASSES] = {"< 10 us", "< 100 us", "< 1 ms", ">= 1 ms"};
+
+	for(int delay_class = 0; delay_class < DELAY_CLASSES; delay_class++) {
+		uint64_t counts[OVERSHOOT_BUCKETS];
+		uint64_t total = 0;
+
+		for(int bucket = 0; bucket < OVERSHOOT_BUCKETS; bucket++) {
+			counts[bucket] = reset ? histogram[delay_class][bucket].exchange(0) : histogram[delay_class][bucket].load();
+			total += counts[bucket];
+		}
+
+		uint64_t requested_ns = reset ? requested_sum_ns[delay_class].exchange(0) : requested_sum_ns[delay_class].load();
+		uint64_t actual_ns = reset ? actual_sum_ns[delay_class].exchange(0) : actual_sum_ns[delay_class].load();
+
+		if(total == 0) {
+			continue;
+		}
+
+		char buckets[256];
+		int length = 0;
+
+		for(int bucket = 0; bucket < OVERSHOOT_BUCKETS && length < (int) sizeof(buckets); bucket++) {
+			if(bucket < OVERSHOOT_BUCKETS - 1) {
+				length += snprintf(buckets + length, sizeof(buckets) - length, " <%u:%llu", OVERSHOOT_LIMITS_US[bucket], (unsigned long long) counts[bucket]);
+			}
+			else {
+				length += snprintf(buckets + length, sizeof(buckets) - length, " more:%llu", (unsigned long long) counts[bucket]);
+			}
+		}
+
+		logger->info("[TIMER] Delays %s: %llu, requested/actual avg %.1f/%.1f us\n",
+			class_names[delay_class], (unsigned long long) total, requested_ns / 1e3 / total, actual_ns / 1e3 / total);
+		logger->info("[TIMER]   overshoot (us):%s\n", buckets);
+	}
+}
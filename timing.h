@@ -0,0 +1,71 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <time.h>
+
+#include <atomic>
+#include <cstdint>
+
+class PrecisionTimer;
+
+extern PrecisionTimer *precision_timer;
+
+constexpr uint64_t NS_PER_SECOND = 1000000000ull;
+
+inline uint64_t monotonic_time_ns() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+// =============================================================
+// PrecisionTimer: calibrated sleep-then-spin delays
+// =============================================================
+
+// The kernel wakes a sleeping thread tens of microseconds after the requested time, which
+// is as long as the settle delays themselves. The timer sleeps until the calibrated wake-up
+// latency before the deadline and spins on CLOCK_MONOTONIC for the rest.
+
+class PrecisionTimer {
+private:
+	// Requested delays: < 10 us, < 100 us, < 1 ms, >= 1 ms
+	static constexpr int DELAY_CLASSES = 4;
+
+	// Overshoot bucket upper bounds in us, the last bucket takes the rest
+	static constexpr int OVERSHOOT_BUCKETS = 10;
+	static constexpr unsigned int OVERSHOOT_LIMITS_US[OVERSHOOT_BUCKETS - 1] = {1, 2, 5, 10, 20, 50, 100, 200, 500};
+
+	uint64_t spin_threshold_ns;
+
+	std::atomic<uint64_t> histogram[DELAY_CLASSES][OVERSHOOT_BUCKETS];
+	std::atomic<uint64_t> requested_sum_ns[DELAY_CLASSES];
+	std::atomic<uint64_t> actual_sum_ns[DELAY_CLASSES];
+
+	bool initialized;
+
+	void record(uint64_t requested_ns, uint64_t actual_ns);
+
+public:
+	PrecisionTimer();
+	~PrecisionTimer();
+
+	// Measures how late the kernel wakes a sleeping thread
+	bool init();
+	void finish();
+
+	void sleep_until_ns(uint64_t deadline_ns);
+	void delay_ns(uint64_t duration_ns) { sleep_until_ns(monotonic_time_ns() + duration_ns); }
+
+	// Plain sleep, for polling intervals where overshoot is harmless (not recorded)
+	void sleep_ns(uint64_t duration_ns);
+
+	uint64_t get_spin_threshold_ns() const { return spin_threshold_ns; }
+
+	void report_statistics(bool reset);
+
+	bool is_initialized() const { return initialized; }
+};
+
+#endif // TIMING_H